@@ -0,0 +1,62 @@
+#include "annotationoverlay.h"
+#include <QPainter>
+#include <QPen>
+#include <QFont>
+#include <QFontMetricsF>
+#include <QPolygonF>
+#include <algorithm>
+
+void drawAnnotationOverlay(QPainter &painter, const FrameAnnotations &ann, const QRectF &frameRect,
+                           const OverlayFilter &filter)
+{
+    painter.save();
+    painter.setPen(QPen(Qt::white, 2));
+    painter.setBrush(Qt::NoBrush);
+    QFont font = painter.font();
+    font.setPixelSize(14);
+    font.setBold(true);
+    painter.setFont(font);
+    QFontMetricsF fm(font);
+
+    for (const FrameLabel& fl : ann.labels) {
+        if (!filter.accepts(fl))
+            continue;
+        QRectF box(frameRect.x() + fl.xmin * frameRect.width(),
+                   frameRect.y() + fl.ymin * frameRect.height(),
+                   (fl.xmax - fl.xmin) * frameRect.width(),
+                   (fl.ymax - fl.ymin) * frameRect.height());
+        painter.drawRect(box);
+        // Label + confidence above box, kept inside the frame
+        QString labelText = QString("%1 %2").arg(fl.label).arg(fl.confidence, 0, 'f', 2);
+        qreal textY = std::max(box.top() - 4, frameRect.top() + fm.ascent() + 2);
+        painter.drawText(QPointF(box.left(), textY), labelText);
+    }
+    painter.restore();
+}
+
+void drawTrackTrail(QPainter &painter, const TrackInfo &track, int frameIdx, const QRectF &frameRect)
+{
+    auto toFrame = [&frameRect](const QPointF &p) {
+        return QPointF(frameRect.x() + p.x() * frameRect.width(), frameRect.y() + p.y() * frameRect.height());
+    };
+
+    int end = static_cast<int>(std::upper_bound(track.frames.begin(), track.frames.end(), frameIdx) - track.frames.begin());
+    if (end == 0)
+        return;
+    QPolygonF path;
+    path.reserve(end);
+    for (int i = 0; i < end; ++i)
+        path << toFrame(track.boxAt(i).center());
+
+    painter.save();
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(QPen(Qt::yellow, 2));
+    painter.setBrush(Qt::NoBrush);
+    painter.drawPolyline(path);
+    if (track.frames[end - 1] == frameIdx) {
+        QRectF box = track.boxAt(end - 1);
+        painter.setPen(QPen(Qt::yellow, 3));
+        painter.drawRect(QRectF(toFrame(box.topLeft()), toFrame(box.bottomRight())));
+    }
+    painter.restore();
+}
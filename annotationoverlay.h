@@ -0,0 +1,33 @@
+#ifndef ANNOTATIONOVERLAY_H
+#define ANNOTATIONOVERLAY_H
+
+#include <QRectF>
+#include <QSet>
+#include <QString>
+#include "annotationparser.h"
+#include "trackindex.h"
+
+class QPainter;
+
+// Which detections the overlay draws
+struct OverlayFilter {
+    float minConfidence = 0.0f;
+    QSet<QString> hiddenLabels;     // Labels not listed are shown, also new ones
+
+    bool accepts(const FrameLabel &fl) const
+    {
+        return fl.confidence >= minConfidence && !hiddenLabels.contains(fl.label);
+    }
+};
+
+// Draws the boxes and "label confidence" texts of ann onto painter.
+// frameRect is where the whole video frame is drawn on the painter, the
+// normalized annotation coordinates are mapped into it.
+void drawAnnotationOverlay(QPainter &painter, const FrameAnnotations &ann, const QRectF &frameRect,
+                           const OverlayFilter &filter = OverlayFilter());
+
+// Draws the path of the box centers of track up to frameIdx, and its box
+// in frameIdx highlighted.
+void drawTrackTrail(QPainter &painter, const TrackInfo &track, int frameIdx, const QRectF &frameRect);
+
+#endif // ANNOTATIONOVERLAY_H
@@ -1,67 +1,784 @@
 #include "annotationparser.h"
-#include <QFile>
-#include <QTextStream>
+#include "memorybudget.h"
+#include <QFileInfo>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QtEndian>
 #include <QRegularExpression>
+#include <QPair>
+#include <algorithm>
+#include <limits>
+#include <cstring>
+#include <cstdlib>
+
+namespace {
+
+// Binary format: header, column table, label dictionary, columns
+const char binaryMagic[8] = { 'Q', 'T', 'A', 'N', 'N', 'B', 'I', 'N' };
+const quint32 binaryVersion = 1;
+const int binaryHeaderSize = 48;
+const int binaryColumnEntrySize = 32;   // name[16], numpy dtype[4], u32 count, u64 offset
+const int binaryColumnNameSize = 16;
+const int binaryDtypeSize = 4;
+// Export buffer per column, flushed to its place in the file when full
+const int binaryFlushBytes = 1024 * 1024;
+
+struct BinaryColumn {
+    const char *name;
+    const char *dtype;
+    int elementSize;
+    quint32 count;
+    qint64 offset;
+    qint64 written;
+    QByteArray data;
+};
+
+template <typename T>
+void appendLE(QByteArray &out, T value)
+{
+    uchar bytes[sizeof(T)];
+    qToLittleEndian<T>(value, bytes);
+    out.append(reinterpret_cast<const char*>(bytes), sizeof(T));
+}
+
+void appendFloatLE(QByteArray &out, float value)
+{
+    quint32 bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    appendLE<quint32>(out, bits);
+}
+
+float readFloatLE(const uchar *p)
+{
+    quint32 bits = qFromLittleEndian<quint32>(p);
+    float value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+qint64 alignTo8(qint64 offset)
+{
+    return (offset + 7) & ~qint64(7);
+}
+
+// One column of a mapped file, checked against the file size
+struct ColumnView {
+    const uchar *data = nullptr;
+    quint32 count = 0;
+    QByteArray dtype;
+};
+
+// Columns a reader needs, with the exact numpy dtype they must have
+struct ExpectedColumn {
+    const char *name;
+    const char *dtype;
+};
+
+// "Frame count: 123 ..." gives 123; the index pass needs nothing else
+bool frameHeaderNumber(const char *line, int &frameNumber)
+{
+    static const char prefix[] = "Frame count:";
+    while (*line == ' ' || *line == '\t')
+        ++line;
+    if (std::strncmp(line, prefix, sizeof(prefix) - 1) != 0)
+        return false;
+    const char *number = line + sizeof(prefix) - 1;
+    char *end = nullptr;
+    long value = std::strtol(number, &end, 10);
+    if (end == number || value < 0 || value > std::numeric_limits<int>::max())
+        return false;
+    frameNumber = static_cast<int>(value);
+    return true;
+}
+
+// Frames of out-of-order text into frame order; of repeated frame numbers
+// the last one in the file is kept, as a map insert did before
+void sortFrames(QVector<FrameAnnotations> &frames)
+{
+    auto notAscending = [](const FrameAnnotations &a, const FrameAnnotations &b) {
+        return a.frameNumber >= b.frameNumber;
+    };
+    if (std::adjacent_find(frames.begin(), frames.end(), notAscending) == frames.end())
+        return;
+    std::stable_sort(frames.begin(), frames.end(), [](const FrameAnnotations &a, const FrameAnnotations &b) {
+        return a.frameNumber < b.frameNumber;
+    });
+    int kept = 0;
+    for (int i = 0; i < frames.size(); ++i) {
+        if (kept > 0 && frames[kept - 1].frameNumber == frames[i].frameNumber)
+            frames[kept - 1] = std::move(frames[i]);
+        else if (kept++ != i)
+            frames[kept - 1] = std::move(frames[i]);
+    }
+    frames.resize(kept);
+}
+
+qint64 framesBytes(const QVector<FrameAnnotations> &frames)
+{
+    // Label strings are shared per page and not counted
+    qint64 bytes = frames.capacity() * qint64(sizeof(FrameAnnotations));
+    for (const FrameAnnotations &frame : frames)
+        bytes += frame.labels.capacity() * qint64(sizeof(FrameLabel));
+    return bytes;
+}
+
+} // namespace
+
+const int AnnotationParser::pageFrames;
+
+AnnotationParser::AnnotationParser()
+{
+    budgetHandle = MemoryBudget::instance().addConsumer(MemoryBudget::Annotations, [this](qint64 bytes) {
+        QMutexLocker locker(&cacheMutex);
+        qint64 freed = evictPages(bytes);
+        reportUsage();
+        return freed;
+    });
+}
+
+AnnotationParser::~AnnotationParser()
+{
+    MemoryBudget::instance().removeConsumer(budgetHandle);
+    clear();
+}
+
+void AnnotationParser::clear()
+{
+    {
+        QMutexLocker locker(&cacheMutex);
+        pageCache.clear();
+        cacheBytes = 0;
+        reportUsage();
+    }
+    pageIndex.clear();
+    minFrame = -1;
+    maxFrame = -1;
+    resumeOffset = 0;
+    parsedSize = 0;
+    binary = false;
+    ordered = true;
+    rangePage = -1;
+    if (binaryFile) {
+        binaryFile->unmap(binaryData);
+        binaryFile.reset();
+    }
+    binaryData = nullptr;
+    columns = BinaryColumns();
+    binaryLabels.clear();
+}
 
 bool AnnotationParser::loadFromFile(const QString& fileName)
 {
-    frameMap.clear();
-    QFile file(fileName);
-    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    clear();
+    loadedFileName = fileName;
+    binary = isBinaryFile(fileName);
+    if (binary)
+        return indexBinary();
+    return indexText(0, nullptr, nullptr);
+}
+
+bool AnnotationParser::loadAppended(int *firstChangedFrame)
+{
+    if (loadedFileName.isEmpty())
+        return false;
+    qint64 size = QFileInfo(loadedFileName).size();
+    if (size == parsedSize)
+        return false;
+    if (binary || size < parsedSize) {
+        // Rewritten from the start, not appended
+        if (firstChangedFrame)
+            *firstChangedFrame = -1;
+        return loadFromFile(loadedFileName);
+    }
+
+    int first = -1;
+    QSet<int> changedPages;
+    if (!indexText(resumeOffset, &first, &changedPages))
+        return false;
+
+    // Pages that got frames are parsed again on next use; out of order, that may be any page
+    {
+        QMutexLocker locker(&cacheMutex);
+        for (int pageNumber : changedPages) {
+            auto it = pageCache.find(pageNumber);
+            if (it == pageCache.end())
+                continue;
+            cacheBytes -= it->page->bytes;
+            pageCache.erase(it);
+        }
+        reportUsage();
+    }
+    if (firstChangedFrame)
+        *firstChangedFrame = first;
+    return true;
+}
+
+bool AnnotationParser::indexText(qint64 offset, int *firstFrame, QSet<int> *changedPages)
+{
+    QFile file(loadedFileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    if (offset > 0 && !file.seek(offset))
         return false;
 
-    QTextStream in(&file);
+    // Only frame headers are looked at, labels are parsed when a page is used.
+    // Each run of frames of one page is a range, a resumed index continues the last one.
+    int first = -1;
+    qint64 lastHeaderOffset = offset;
+    char line[4096];
+    bool atLineStart = true;
+    for (;;) {
+        qint64 lineOffset = file.pos();
+        qint64 len = file.readLine(line, sizeof(line));
+        if (len <= 0)
+            break;
+        // A line longer than the buffer comes in pieces, only the first can be a header
+        bool lineStart = atLineStart;
+        atLineStart = line[len - 1] == '\n';
+        int frameNumber = 0;
+        if (!lineStart || !frameHeaderNumber(line, frameNumber))
+            continue;
+
+        if (frameNumber < maxFrame)
+            ordered = false;
+        if (first < 0 || frameNumber < first)
+            first = frameNumber;
+        lastHeaderOffset = lineOffset;
+
+        int pageNumber = frameNumber / pageFrames;
+        if (pageNumber != rangePage) {
+            if (rangePage >= 0)
+                pageIndex[rangePage].ranges.last().second = lineOffset;
+            PageRef &ref = pageIndex[pageNumber];
+            if (ref.ranges.isEmpty()) {
+                ref.firstFrame = frameNumber;
+                ref.lastFrame = frameNumber;
+            }
+            ref.ranges.push_back(Range(lineOffset, lineOffset));
+            rangePage = pageNumber;
+        }
+        PageRef &ref = pageIndex[pageNumber];
+        ref.firstFrame = std::min(ref.firstFrame, frameNumber);
+        ref.lastFrame = std::max(ref.lastFrame, frameNumber);
+        if (changedPages)
+            changedPages->insert(pageNumber);
+        minFrame = minFrame < 0 ? frameNumber : std::min(minFrame, frameNumber);
+        maxFrame = std::max(maxFrame, frameNumber);
+    }
+    if (rangePage >= 0)
+        pageIndex[rangePage].ranges.last().second = file.pos();
+
+    // Next append starts at the last frame again, it may still be growing
+    resumeOffset = lastHeaderOffset;
+    parsedSize = file.pos();
+    if (firstFrame)
+        *firstFrame = first;
+    return true;
+}
+
+QVector<FrameAnnotations> AnnotationParser::parseText(const QVector<Range> &ranges) const
+{
+    QVector<FrameAnnotations> frames;
+    QFile file(loadedFileName);
+    // Not in text mode, the index holds byte offsets; trimmed() drops any '\r'
+    if (!file.open(QIODevice::ReadOnly))
+        return frames;
+
+    static const QRegularExpression frameRe(R"(Frame count:\s*(\d+)\s+Width:\s*(\d+)\s+Heigth:\s*(\d+))");
+    static const QRegularExpression labelRe(R"(Label:\s*([^\s]+)\s+ID:\s*(\d+)\s+Confidence:\s*([\d.]+)\s+Detection count:\s*(\d+)\s+Position:\s*center=\(([\d.]+),\s*([\d.]+)\)\s+Bounds:\s*xmin=([\d.]+),\s*ymin=([\d.]+),\s*xmax=([\d.]+),\s*ymax=([\d.]+))");
+
+    // One string per label name in the page instead of one per detection
+    QHash<QString, QString> labelNames;
     FrameAnnotations currentFrame;
-    while (!in.atEnd()) {
-        QString line = in.readLine().trimmed();
-        if (line.startsWith("Frame count:")) {
-            // If we already have a frame, store it
-            if (currentFrame.frameNumber >= 0)
-                frameMap[currentFrame.frameNumber] = currentFrame;
-
-            // Parse frame info
-            QRegularExpression re(R"(Frame count:\s*(\d+)\s+Width:\s*(\d+)\s+Heigth:\s*(\d+))");
-            auto match = re.match(line);
-            if (match.hasMatch()) {
-                currentFrame = FrameAnnotations();
-                currentFrame.frameNumber = match.captured(1).toInt();
-                int w = match.captured(2).toInt();
-                int h = match.captured(3).toInt();
-                currentFrame.size = QSize(w, h);
-                currentFrame.labels.clear();
+    auto storeFrame = [&]() {
+        if (currentFrame.frameNumber < 0)
+            return;
+        // A repeated header replaces the frame, as a map insert did before
+        if (!frames.isEmpty() && frames.last().frameNumber == currentFrame.frameNumber)
+            frames.last() = currentFrame;
+        else
+            frames.push_back(currentFrame);
+    };
+
+    for (const Range &range : ranges) {
+        if (!file.seek(range.first))
+            break;
+        while (!file.atEnd() && file.pos() < range.second) {
+            QString line = QString::fromUtf8(file.readLine()).trimmed();
+            if (line.startsWith("Frame count:")) {
+                // If we already have a frame, store it
+                storeFrame();
+
+                // Parse frame info
+                auto match = frameRe.match(line);
+                if (match.hasMatch()) {
+                    currentFrame = FrameAnnotations();
+                    currentFrame.frameNumber = match.captured(1).toInt();
+                    int w = match.captured(2).toInt();
+                    int h = match.captured(3).toInt();
+                    currentFrame.size = QSize(w, h);
+                    currentFrame.labels.clear();
+                }
+            } else if (line.startsWith("Label:")) {
+                // Parse label info
+                auto match = labelRe.match(line);
+                if (match.hasMatch()) {
+                    FrameLabel fl;
+                    QString name = match.captured(1);
+                    fl.label = labelNames.value(name, name);
+                    labelNames.insert(fl.label, fl.label);
+                    fl.id = match.captured(2).toInt();
+                    fl.confidence = match.captured(3).toFloat();
+                    fl.detectionCount = match.captured(4).toInt();
+                    fl.centerX = match.captured(5).toFloat();
+                    fl.centerY = match.captured(6).toFloat();
+                    fl.xmin = match.captured(7).toFloat();
+                    fl.ymin = match.captured(8).toFloat();
+                    fl.xmax = match.captured(9).toFloat();
+                    fl.ymax = match.captured(10).toFloat();
+                    currentFrame.labels.push_back(fl);
+                }
             }
-        } else if (line.startsWith("Label:")) {
-            // Parse label info
-            QRegularExpression re(R"(Label:\s*([^\s]+)\s+ID:\s*(\d+)\s+Confidence:\s*([\d.]+)\s+Detection count:\s*(\d+)\s+Position:\s*center=\(([\d.]+),\s*([\d.]+)\)\s+Bounds:\s*xmin=([\d.]+),\s*ymin=([\d.]+),\s*xmax=([\d.]+),\s*ymax=([\d.]+))");
-            auto match = re.match(line);
-            if (match.hasMatch()) {
-                FrameLabel fl;
-                fl.label = match.captured(1);
-                fl.id = match.captured(2).toInt();
-                fl.confidence = match.captured(3).toFloat();
-                fl.detectionCount = match.captured(4).toInt();
-                fl.centerX = match.captured(5).toFloat();
-                fl.centerY = match.captured(6).toFloat();
-                fl.xmin = match.captured(7).toFloat();
-                fl.ymin = match.captured(8).toFloat();
-                fl.xmax = match.captured(9).toFloat();
-                fl.ymax = match.captured(10).toFloat();
-                currentFrame.labels.push_back(fl);
+            // Drop lines not matching the above
+        }//end while
+        // Store the last frame of the range
+        storeFrame();
+        currentFrame = FrameAnnotations();
+    }
+    sortFrames(frames);
+    for (FrameAnnotations &frame : frames)
+        frame.labels.shrink_to_fit();
+    return frames;
+}
+
+AnnotationParser::PagePtr AnnotationParser::page(int pageNumber) const
+{
+    {
+        QMutexLocker locker(&cacheMutex);
+        auto it = pageCache.find(pageNumber);
+        if (it != pageCache.end()) {
+            it->lastUse = ++useCounter;
+            return it->page;
+        }
+    }
+    auto ref = pageIndex.constFind(pageNumber);
+    if (ref == pageIndex.constEnd())
+        return PagePtr();
+
+    // Parsed unlocked, so parallel readers work on different pages at once
+    PagePtr loaded = readPage(ref.value());
+
+    QMutexLocker locker(&cacheMutex);
+    auto it = pageCache.find(pageNumber);
+    if (it != pageCache.end()) {
+        // Another thread read it meanwhile
+        it->lastUse = ++useCounter;
+        return it->page;
+    }
+    CachedPage cached;
+    cached.page = loaded;
+    cached.lastUse = ++useCounter;
+    pageCache.insert(pageNumber, cached);
+    cacheBytes += loaded->bytes;
+    reportUsage();
+
+    // A long scan on a worker thread cannot wait for enforce(): over budget, it
+    // frees at once what this page added. The rest of the overrun is left to
+    // enforce(), which evicts the cheaper categories first.
+    MemoryBudget &budget = MemoryBudget::instance();
+    qint64 over = std::min(budget.used() - budget.budget(), loaded->bytes);
+    if (over > 0) {
+        evictPages(over);
+        reportUsage();
+    }
+    return loaded;
+}
+
+AnnotationParser::PagePtr AnnotationParser::readPage(const PageRef &ref) const
+{
+    std::shared_ptr<Page> page = std::make_shared<Page>();
+    if (!binary) {
+        page->frames = parseText(ref.ranges);
+        page->bytes = framesBytes(page->frames);
+        return page;
+    }
+
+    // Rows of the mapped frame table
+    const Range &rows = ref.ranges.first();
+    page->frames.reserve(static_cast<int>(rows.second - rows.first));
+    for (qint64 f = rows.first; f < rows.second; ++f) {
+        FrameAnnotations frame;
+        frame.frameNumber = qFromLittleEndian<qint32>(columns.frameNumber + 4 * f);
+        frame.size = QSize(qFromLittleEndian<qint32>(columns.width + 4 * f),
+                           qFromLittleEndian<qint32>(columns.height + 4 * f));
+        quint32 rowStart = qFromLittleEndian<quint32>(columns.rowStart + 4 * f);
+        quint32 rows = qFromLittleEndian<quint32>(columns.rowCount + 4 * f);
+
+        frame.labels.resize(rows);
+        for (quint32 i = 0; i < rows; ++i) {
+            qint64 r = qint64(rowStart) + i;
+            FrameLabel &fl = frame.labels[i];
+            fl.label = binaryLabels[qFromLittleEndian<quint16>(columns.label + 2 * r)];  // Shared, not copied per row
+            fl.id = qFromLittleEndian<qint32>(columns.track + 4 * r);
+            fl.confidence = readFloatLE(columns.confidence + 4 * r);
+            fl.detectionCount = qFromLittleEndian<qint32>(columns.detCount + 4 * r);
+            fl.centerX = readFloatLE(columns.centerX + 4 * r);
+            fl.centerY = readFloatLE(columns.centerY + 4 * r);
+            fl.xmin = readFloatLE(columns.xmin + 4 * r);
+            fl.ymin = readFloatLE(columns.ymin + 4 * r);
+            fl.xmax = readFloatLE(columns.xmax + 4 * r);
+            fl.ymax = readFloatLE(columns.ymax + 4 * r);
+        }
+        page->frames.push_back(frame);
+    }
+    page->bytes = framesBytes(page->frames);
+    return page;
+}
+
+qint64 AnnotationParser::evictPages(qint64 bytes) const
+{
+    if (bytes <= 0)
+        return 0;
+
+    // Least recently used first; pages a reader still holds stay
+    QVector<QPair<quint64, int>> candidates;
+    for (auto it = pageCache.constBegin(); it != pageCache.constEnd(); ++it) {
+        if (it->page.use_count() == 1)
+            candidates.push_back(qMakePair(it->lastUse, it.key()));
+    }
+    std::sort(candidates.begin(), candidates.end());
+
+    qint64 freed = 0;
+    for (const auto &candidate : candidates) {
+        if (freed >= bytes)
+            break;
+        auto it = pageCache.find(candidate.second);
+        freed += it->page->bytes;
+        cacheBytes -= it->page->bytes;
+        pageCache.erase(it);
+    }
+    return freed;
+}
+
+void AnnotationParser::reportUsage() const
+{
+    MemoryBudget::instance().setUsage(budgetHandle, cacheBytes);
+}
+
+std::shared_ptr<const FrameAnnotations> AnnotationParser::getAnnotations(int frameNumber) const
+{
+    if (frameNumber < 0 || !pageIndex.contains(frameNumber / pageFrames))
+        return nullptr;
+    PagePtr p = page(frameNumber / pageFrames);
+    if (!p)
+        return nullptr;
+    auto it = std::lower_bound(p->frames.constBegin(), p->frames.constEnd(), frameNumber,
+                               [](const FrameAnnotations &frame, int number) { return frame.frameNumber < number; });
+    if (it == p->frames.constEnd() || it->frameNumber != frameNumber)
+        return nullptr;
+    // Shares ownership of the page
+    return std::shared_ptr<const FrameAnnotations>(p, &*it);
+}
+
+void AnnotationParser::forEachFrame(int first, int last, const std::function<void(const FrameAnnotations&)> &fn) const
+{
+    first = std::max(first, 0);
+    if (last < first)
+        return;
+    for (auto ref = pageIndex.lowerBound(first / pageFrames);
+         ref != pageIndex.constEnd() && ref.key() <= last / pageFrames; ++ref) {
+        if (ref->lastFrame < first)
+            continue;
+        // Held while fn runs, eviction leaves it alone
+        PagePtr p = page(ref.key());
+        if (!p)
+            continue;
+        for (const FrameAnnotations &frame : p->frames) {
+            if (frame.frameNumber < first)
+                continue;
+            if (frame.frameNumber > last)
+                return;
+            fn(frame);
+        }
+    }
+}
+
+void AnnotationParser::forEachFrame(const std::function<void(const FrameAnnotations&)> &fn) const
+{
+    forEachFrame(0, std::numeric_limits<int>::max(), fn);
+}
+
+bool AnnotationParser::isBinaryFile(const QString &fileName)
+{
+    QFile file(fileName);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+    return file.read(sizeof(binaryMagic)) == QByteArray(binaryMagic, sizeof(binaryMagic));
+}
+
+QString AnnotationParser::annotationFileFor(const QString &videoPath)
+{
+    QFileInfo fi(videoPath);
+    QString base = fi.path() + "/" + fi.completeBaseName();
+    QFileInfo binaryFile(base + ".qann");
+    QFileInfo textFile(base + ".txt");
+    if (binaryFile.exists() && (!textFile.exists() || binaryFile.lastModified() >= textFile.lastModified()))
+        return binaryFile.filePath();
+    return textFile.filePath();
+}
+
+bool AnnotationParser::saveBinary(const QString &fileName) const
+{
+    BinaryColumn frameNumberCol = { "frame_number", "<i4", 4, 0, 0, 0, QByteArray() };
+    BinaryColumn widthCol       = { "width",        "<i4", 4, 0, 0, 0, QByteArray() };
+    BinaryColumn heightCol      = { "height",       "<i4", 4, 0, 0, 0, QByteArray() };
+    BinaryColumn rowStartCol    = { "row_start",    "<u4", 4, 0, 0, 0, QByteArray() };
+    BinaryColumn rowCountCol    = { "row_count",    "<u4", 4, 0, 0, 0, QByteArray() };
+    BinaryColumn frameCol       = { "frame",        "<i4", 4, 0, 0, 0, QByteArray() };
+    BinaryColumn labelCol       = { "label",        "<u2", 2, 0, 0, 0, QByteArray() };
+    BinaryColumn trackCol       = { "track",        "<i4", 4, 0, 0, 0, QByteArray() };
+    BinaryColumn confidenceCol  = { "confidence",   "<f4", 4, 0, 0, 0, QByteArray() };
+    BinaryColumn detCountCol    = { "det_count",    "<i4", 4, 0, 0, 0, QByteArray() };
+    BinaryColumn centerXCol     = { "center_x",     "<f4", 4, 0, 0, 0, QByteArray() };
+    BinaryColumn centerYCol     = { "center_y",     "<f4", 4, 0, 0, 0, QByteArray() };
+    BinaryColumn xminCol        = { "xmin",         "<f4", 4, 0, 0, 0, QByteArray() };
+    BinaryColumn yminCol        = { "ymin",         "<f4", 4, 0, 0, 0, QByteArray() };
+    BinaryColumn xmaxCol        = { "xmax",         "<f4", 4, 0, 0, 0, QByteArray() };
+    BinaryColumn ymaxCol        = { "ymax",         "<f4", 4, 0, 0, 0, QByteArray() };
+    BinaryColumn *frameColumns[] = { &frameNumberCol, &widthCol, &heightCol, &rowStartCol, &rowCountCol };
+    BinaryColumn *rowColumns[] = { &frameCol, &labelCol, &trackCol, &confidenceCol, &detCountCol,
+                                   &centerXCol, &centerYCol, &xminCol, &yminCol, &xmaxCol, &ymaxCol };
+
+    // First pass: sizes and the label dictionary, labels numbered in order of first appearance
+    QStringList labels;
+    QHash<QString, int> labelIds;
+    quint32 frameCount = 0;
+    quint32 rows = 0;
+    bool tooManyLabels = false;
+    forEachFrame([&](const FrameAnnotations &frame) {
+        ++frameCount;
+        rows += static_cast<quint32>(frame.labels.size());
+        for (const FrameLabel &fl : frame.labels) {
+            if (!labelIds.contains(fl.label)) {
+                labelIds.insert(fl.label, labels.size());
+                labels << fl.label;
             }
         }
-        // Drop lines not matching the above
-    }//end while
-    // Store the last frame
-    if (currentFrame.frameNumber >= 0)
-        frameMap[currentFrame.frameNumber] = currentFrame;
+        tooManyLabels = tooManyLabels || labels.size() > 0x10000;
+    });
+    if (tooManyLabels)
+        return false;
 
-    return true;
+    QVector<BinaryColumn*> columnList;
+    for (BinaryColumn *col : frameColumns) {
+        col->count = frameCount;
+        columnList << col;
+    }
+    for (BinaryColumn *col : rowColumns) {
+        col->count = rows;
+        columnList << col;
+    }
+
+    // Layout: header, column table, label dictionary (UTF-8, one label per line), columns
+    QByteArray labelBytes = labels.join('\n').toUtf8();
+    qint64 labelsOffset = binaryHeaderSize + binaryColumnEntrySize * columnList.size();
+    qint64 offset = alignTo8(labelsOffset + labelBytes.size());
+    QByteArray columnTable;
+    for (BinaryColumn *col : columnList) {
+        col->offset = offset;
+        offset = alignTo8(offset + qint64(col->count) * col->elementSize);
+        // Zero padded
+        columnTable += QByteArray(col->name).leftJustified(binaryColumnNameSize, '\0', true);
+        columnTable += QByteArray(col->dtype).leftJustified(binaryDtypeSize, '\0', true);
+        appendLE<quint32>(columnTable, col->count);
+        appendLE<quint64>(columnTable, static_cast<quint64>(col->offset));
+    }
+
+    QByteArray header(binaryMagic, sizeof(binaryMagic));
+    appendLE<quint32>(header, binaryVersion);
+    appendLE<quint32>(header, static_cast<quint32>(columnList.size()));
+    appendLE<quint32>(header, frameCount);
+    appendLE<quint32>(header, rows);
+    appendLE<quint32>(header, static_cast<quint32>(labels.size()));
+    appendLE<quint32>(header, 0);
+    appendLE<quint64>(header, static_cast<quint64>(labelsOffset));
+    appendLE<quint64>(header, static_cast<quint64>(labelBytes.size()));
+
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(header);
+    file.write(columnTable);
+    file.write(labelBytes);
+    // Zero filled up to the end, so padding and empty columns read as zeros
+    file.resize(offset);
+
+    // Second pass: columns are buffered and written to their place in pieces
+    bool ok = true;
+    auto flush = [&](BinaryColumn *col) {
+        if (col->data.isEmpty())
+            return;
+        ok = ok && file.seek(col->offset + col->written) && file.write(col->data) == col->data.size();
+        col->written += col->data.size();
+        col->data.clear();
+    };
+    quint32 row = 0;
+    forEachFrame([&](const FrameAnnotations &frame) {
+        appendLE<qint32>(frameNumberCol.data, frame.frameNumber);
+        appendLE<qint32>(widthCol.data, frame.size.width());
+        appendLE<qint32>(heightCol.data, frame.size.height());
+        appendLE<quint32>(rowStartCol.data, row);
+        appendLE<quint32>(rowCountCol.data, static_cast<quint32>(frame.labels.size()));
+
+        for (const FrameLabel &fl : frame.labels) {
+            appendLE<qint32>(frameCol.data, frame.frameNumber);
+            appendLE<quint16>(labelCol.data, static_cast<quint16>(labelIds.value(fl.label)));
+            appendLE<qint32>(trackCol.data, fl.id);
+            appendFloatLE(confidenceCol.data, fl.confidence);
+            appendLE<qint32>(detCountCol.data, fl.detectionCount);
+            appendFloatLE(centerXCol.data, fl.centerX);
+            appendFloatLE(centerYCol.data, fl.centerY);
+            appendFloatLE(xminCol.data, fl.xmin);
+            appendFloatLE(yminCol.data, fl.ymin);
+            appendFloatLE(xmaxCol.data, fl.xmax);
+            appendFloatLE(ymaxCol.data, fl.ymax);
+            ++row;
+        }
+        for (BinaryColumn *col : columnList) {
+            if (col->data.size() >= binaryFlushBytes)
+                flush(col);
+        }
+    });
+    for (BinaryColumn *col : columnList)
+        flush(col);
+
+    if (!ok || row != rows) {
+        file.cancelWriting();
+        return false;
+    }
+    return file.commit();
 }
 
-const FrameAnnotations* AnnotationParser::getAnnotations(int frameNumber) const
+bool AnnotationParser::indexBinary()
 {
-    auto it = frameMap.find(frameNumber);
-    if (it != frameMap.end())
-        return &it.value();
-    return nullptr;
+    binaryFile.reset(new QFile(loadedFileName));
+    if (!binaryFile->open(QIODevice::ReadOnly) || binaryFile->size() < binaryHeaderSize) {
+        binaryFile.reset();
+        return false;
+    }
+    const qint64 fileSize = binaryFile->size();
+    // Stays mapped: pages are decoded from the columns in place
+    binaryData = binaryFile->map(0, fileSize);
+    if (!binaryData) {
+        binaryFile.reset();
+        return false;
+    }
+    const uchar *data = binaryData;
+
+    auto fail = [&]() {
+        clear();
+        return false;
+    };
+
+    quint32 version = qFromLittleEndian<quint32>(data + 8);
+    quint32 columnCount = qFromLittleEndian<quint32>(data + 12);
+    quint32 frameCount = qFromLittleEndian<quint32>(data + 16);
+    quint32 rowCount = qFromLittleEndian<quint32>(data + 20);
+    quint64 labelsOffset = qFromLittleEndian<quint64>(data + 32);
+    quint64 labelsSize = qFromLittleEndian<quint64>(data + 40);
+    if (version != binaryVersion
+            || binaryHeaderSize + quint64(binaryColumnEntrySize) * columnCount > quint64(fileSize)
+            || labelsOffset + labelsSize > quint64(fileSize))
+        return fail();
+
+    binaryLabels = QString::fromUtf8(reinterpret_cast<const char*>(data + labelsOffset),
+                                     static_cast<int>(labelsSize)).split('\n');
+
+    QHash<QByteArray, ColumnView> views;
+    for (quint32 i = 0; i < columnCount; ++i) {
+        const uchar *entry = data + binaryHeaderSize + binaryColumnEntrySize * i;
+        QByteArray name(reinterpret_cast<const char*>(entry), binaryColumnNameSize);
+        QByteArray dtype(reinterpret_cast<const char*>(entry + binaryColumnNameSize), binaryDtypeSize);
+        name.truncate(name.indexOf('\0') < 0 ? name.size() : name.indexOf('\0'));
+        dtype.truncate(dtype.indexOf('\0') < 0 ? dtype.size() : dtype.indexOf('\0'));
+        quint32 count = qFromLittleEndian<quint32>(entry + 20);
+        quint64 offset = qFromLittleEndian<quint64>(entry + 24);
+        int elementSize = dtype.size() == 3 ? dtype.at(2) - '0' : 0;
+        if (elementSize <= 0 || elementSize > 8 || offset + quint64(count) * elementSize > quint64(fileSize))
+            return fail();
+        ColumnView view;
+        view.data = data + offset;
+        view.count = count;
+        view.dtype = dtype;
+        views.insert(name, view);
+    }
+
+    // Readers skip columns they do not know, so later versions can add some.
+    // Known ones must match exactly: same width but other type or byte order reads as garbage.
+    const ExpectedColumn frameColumns[] = { { "frame_number", "<i4" }, { "width", "<i4" }, { "height", "<i4" },
+                                            { "row_start", "<u4" }, { "row_count", "<u4" } };
+    const ExpectedColumn rowColumns[] = { { "label", "<u2" }, { "track", "<i4" }, { "confidence", "<f4" },
+                                          { "det_count", "<i4" }, { "center_x", "<f4" }, { "center_y", "<f4" },
+                                          { "xmin", "<f4" }, { "ymin", "<f4" }, { "xmax", "<f4" }, { "ymax", "<f4" } };
+    for (const ExpectedColumn &col : frameColumns) {
+        if (!views.contains(col.name) || views.value(col.name).count != frameCount
+                || views.value(col.name).dtype != col.dtype)
+            return fail();
+    }
+    for (const ExpectedColumn &col : rowColumns) {
+        if (!views.contains(col.name) || views.value(col.name).count != rowCount
+                || views.value(col.name).dtype != col.dtype)
+            return fail();
+    }
+    columns.frameNumber = views.value("frame_number").data;
+    columns.width = views.value("width").data;
+    columns.height = views.value("height").data;
+    columns.rowStart = views.value("row_start").data;
+    columns.rowCount = views.value("row_count").data;
+    columns.label = views.value("label").data;
+    columns.track = views.value("track").data;
+    columns.confidence = views.value("confidence").data;
+    columns.detCount = views.value("det_count").data;
+    columns.centerX = views.value("center_x").data;
+    columns.centerY = views.value("center_y").data;
+    columns.xmin = views.value("xmin").data;
+    columns.ymin = views.value("ymin").data;
+    columns.xmax = views.value("xmax").data;
+    columns.ymax = views.value("ymax").data;
+
+    // Checked once here, so reading a page needs no checks
+    for (quint32 r = 0; r < rowCount; ++r) {
+        if (qFromLittleEndian<quint16>(columns.label + 2 * r) >= binaryLabels.size())
+            return fail();
+    }
+
+    // Page index from the frame table; the writer stores frames in order
+    int currentPage = -1;
+    for (quint32 f = 0; f < frameCount; ++f) {
+        int frameNumber = qFromLittleEndian<qint32>(columns.frameNumber + 4 * f);
+        quint32 rowStart = qFromLittleEndian<quint32>(columns.rowStart + 4 * f);
+        quint32 rows = qFromLittleEndian<quint32>(columns.rowCount + 4 * f);
+        if (frameNumber < 0 || frameNumber <= maxFrame || quint64(rowStart) + rows > rowCount)
+            return fail();
+
+        int pageNumber = frameNumber / pageFrames;
+        if (pageNumber != currentPage) {
+            if (currentPage >= 0)
+                pageIndex[currentPage].ranges.first().second = f;
+            PageRef ref;
+            ref.ranges.push_back(Range(f, f));
+            ref.firstFrame = frameNumber;
+            pageIndex.insert(pageNumber, ref);
+            currentPage = pageNumber;
+        }
+        pageIndex[currentPage].lastFrame = frameNumber;
+        if (minFrame < 0)
+            minFrame = frameNumber;
+        maxFrame = frameNumber;
+    }
+    if (currentPage >= 0)
+        pageIndex[currentPage].ranges.first().second = frameCount;
+
+    parsedSize = fileSize;
+    return true;
 }
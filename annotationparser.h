@@ -2,9 +2,18 @@
 #define ANNOTATIONPARSER_H
 
 #include <QString>
+#include <QStringList>
 #include <QSize>
 #include <QMap>
+#include <QHash>
+#include <QSet>
+#include <QPair>
+#include <QVector>
+#include <QMutex>
+#include <QFile>
 #include <vector>
+#include <memory>
+#include <functional>
 
 struct FrameLabel {
     QString label;
@@ -21,19 +30,124 @@ struct FrameAnnotations {
     std::vector<FrameLabel> labels;
 };
 
+// Annotations are kept in pages of pageFrames frame numbers. Loading only
+// indexes where each page is in the file (byte ranges of the text, row range
+// of the mapped binary); pages are parsed on first use and the least
+// recently used ones are dropped when the memory budget is exceeded.
 class AnnotationParser
 {
 public:
-    AnnotationParser() {}
+    static const int pageFrames = 1024;
 
+    AnnotationParser();
+    ~AnnotationParser();
+
+    // Loads the text format, or the binary one (see saveBinary) when the
+    // file starts with its magic
     bool loadFromFile(const QString& fileName);
+    // Parses what was appended to the file since the last load (detection
+    // still running). The last frame is parsed again, it may have been
+    // incomplete. Returns false if nothing new; firstChangedFrame gets the
+    // lowest frame number that was (re)parsed, or -1 if the file shrank and
+    // was loaded again from the start.
+    bool loadAppended(int *firstChangedFrame = nullptr);
+    const QString &fileName() const { return loadedFileName; }
+
+    bool isEmpty() const { return pageIndex.isEmpty(); }
+    // False when the frame numbers of a text file go back somewhere: pages
+    // are then read from several places of the file and sorted, which is slower
+    bool isOrdered() const { return ordered; }
+    int firstFrame() const { return minFrame; }     // -1 when empty
+    int lastFrame() const { return maxFrame; }
+
+    // Annotations of frameNumber, null if it has none. Points into its page
+    // and keeps the page loaded while held, nothing is copied.
+    std::shared_ptr<const FrameAnnotations> getAnnotations(int frameNumber) const;
+    // Calls fn for every annotated frame in [first, last] in frame order.
+    // May be called from several threads at once.
+    void forEachFrame(int first, int last, const std::function<void(const FrameAnnotations&)> &fn) const;
+    void forEachFrame(const std::function<void(const FrameAnnotations&)> &fn) const;
 
-    // Returns annotation for frameNumber, or nullptr if not found
-    const FrameAnnotations* getAnnotations(int frameNumber) const;
-    QMap<int, FrameAnnotations> frameMap;
+    // Columnar little-endian export for external analysis, layout in README.
+    // Every column is a fixed-width array, 8-byte aligned, so numpy can memmap it.
+    bool saveBinary(const QString &fileName) const;
+    static bool isBinaryFile(const QString &fileName);
+    // Annotation file of a video: the .qann export next to it, unless the
+    // .txt was written after it
+    static QString annotationFileFor(const QString &videoPath);
 
 private:
+    struct Page {
+        QVector<FrameAnnotations> frames;   // Ascending frame numbers
+        qint64 bytes = 0;
+    };
+    typedef std::shared_ptr<const Page> PagePtr;
+
+    // Text: byte ranges of the page, one per run of its frames in the file.
+    // Binary: a single row range of the frame table.
+    typedef QPair<qint64, qint64> Range;
+    struct PageRef {
+        QVector<Range> ranges;
+        int firstFrame = 0;
+        int lastFrame = 0;
+    };
+
+    struct CachedPage {
+        PagePtr page;
+        quint64 lastUse = 0;
+    };
+
+    // Columns of the mapped binary file
+    struct BinaryColumns {
+        const uchar *frameNumber = nullptr;
+        const uchar *width = nullptr;
+        const uchar *height = nullptr;
+        const uchar *rowStart = nullptr;
+        const uchar *rowCount = nullptr;
+        const uchar *label = nullptr;
+        const uchar *track = nullptr;
+        const uchar *confidence = nullptr;
+        const uchar *detCount = nullptr;
+        const uchar *centerX = nullptr;
+        const uchar *centerY = nullptr;
+        const uchar *xmin = nullptr;
+        const uchar *ymin = nullptr;
+        const uchar *xmax = nullptr;
+        const uchar *ymax = nullptr;
+    };
+
+    void clear();
+    bool indexText(qint64 offset, int *firstFrame, QSet<int> *changedPages);
+    bool indexBinary();
+    QVector<FrameAnnotations> parseText(const QVector<Range> &ranges) const;
+    PagePtr page(int pageNumber) const;
+    PagePtr readPage(const PageRef &ref) const;
+    // Both with cacheMutex held
+    qint64 evictPages(qint64 bytes) const;
+    void reportUsage() const;
+
+    QString loadedFileName;
+    qint64 resumeOffset = 0;    // Start of the last frame header
+    qint64 parsedSize = 0;
+    bool binary = false;
+    bool ordered = true;
+    int rangePage = -1;         // Page of the last range, continued by loadAppended
+    QMap<int, PageRef> pageIndex;
+    int minFrame = -1;
+    int maxFrame = -1;
+
+    std::unique_ptr<QFile> binaryFile;  // Stays mapped while loaded
+    uchar *binaryData = nullptr;
+    BinaryColumns columns;
+    QStringList binaryLabels;
+
+    mutable QMutex cacheMutex;
+    mutable QHash<int, CachedPage> pageCache;
+    mutable qint64 cacheBytes = 0;
+    mutable quint64 useCounter = 0;
+    int budgetHandle;
 
+    Q_DISABLE_COPY(AnnotationParser)
 };
 
 #endif // ANNOTATIONPARSER_H
@@ -0,0 +1,256 @@
+#include "annotationstats.h"
+#include <QThread>
+#include <QtConcurrent>
+#include <QDataStream>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Blocks handled by one task of the reduction, labels indexed locally
+struct Chunk {
+    int firstBlock = 0;
+    int lastBlock = -1;
+    QStringList labels;
+    QVector<AnnotationStats::Summary> blocks;
+};
+
+template <typename LabelIndexFn>
+void accumulate(AnnotationStats::Summary &summary, const FrameAnnotations &frame, LabelIndexFn labelIndexOf)
+{
+    summary.frames += 1;
+    summary.boxes += static_cast<qint64>(frame.labels.size());
+    int boxesBin = std::min(static_cast<int>(frame.labels.size()), AnnotationStats::maxBoxesPerFrame);
+    summary.boxesPerFrameHistogram[boxesBin] += 1;
+
+    for (const FrameLabel &fl : frame.labels) {
+        int idx = labelIndexOf(fl.label);
+        if (idx >= 0) {
+            if (idx >= summary.labelCounts.size()) {
+                summary.labelCounts.resize(idx + 1);
+                summary.labelConfidenceSum.resize(idx + 1);
+            }
+            summary.labelCounts[idx] += 1;
+            summary.labelConfidenceSum[idx] += fl.confidence;
+        }
+        int confBin = static_cast<int>(fl.confidence * AnnotationStats::confidenceBins);
+        summary.confidenceHistogram[std::max(0, std::min(confBin, AnnotationStats::confidenceBins - 1))] += 1;
+        double area = std::max(0.0f, fl.xmax - fl.xmin) * std::max(0.0f, fl.ymax - fl.ymin);
+        int sizeBin = static_cast<int>(std::sqrt(area) * AnnotationStats::sizeBins);
+        summary.sizeHistogram[std::max(0, std::min(sizeBin, AnnotationStats::sizeBins - 1))] += 1;
+    }
+}
+
+template <typename T>
+void addVector(QVector<T> &to, const QVector<T> &from, int sign)
+{
+    if (to.size() < from.size())
+        to.resize(from.size());
+    for (int i = 0; i < from.size(); ++i)
+        to[i] += sign * from[i];
+}
+
+} // namespace
+
+const int AnnotationStats::blockFrames;
+const int AnnotationStats::confidenceBins;
+const int AnnotationStats::sizeBins;
+const int AnnotationStats::maxBoxesPerFrame;
+
+AnnotationStats::Summary::Summary()
+    : confidenceHistogram(confidenceBins),
+      sizeHistogram(sizeBins),
+      boxesPerFrameHistogram(maxBoxesPerFrame + 1)
+{
+}
+
+void AnnotationStats::Summary::add(const Summary &other, int sign)
+{
+    frames += sign * other.frames;
+    boxes += sign * other.boxes;
+    addVector(labelCounts, other.labelCounts, sign);
+    addVector(labelConfidenceSum, other.labelConfidenceSum, sign);
+    addVector(confidenceHistogram, other.confidenceHistogram, sign);
+    addVector(sizeHistogram, other.sizeHistogram, sign);
+    addVector(boxesPerFrameHistogram, other.boxesPerFrameHistogram, sign);
+}
+
+void AnnotationStats::clear()
+{
+    labelNames.clear();
+    labelIndex.clear();
+    prefix.clear();
+    minFrame = -1;
+    maxFrame = -1;
+}
+
+void AnnotationStats::save(QDataStream &out) const
+{
+    out << labelNames << qint32(minFrame) << qint32(maxFrame) << qint32(prefix.size());
+    for (const Summary &summary : prefix) {
+        out << summary.frames << summary.boxes << summary.labelCounts << summary.labelConfidenceSum
+            << summary.confidenceHistogram << summary.sizeHistogram << summary.boxesPerFrameHistogram;
+    }
+}
+
+bool AnnotationStats::load(QDataStream &in)
+{
+    clear();
+    qint32 first = -1, last = -1, count = 0;
+    in >> labelNames >> first >> last >> count;
+    if (in.status() != QDataStream::Ok || count < 0)
+        count = 0;
+    prefix.reserve(count);
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        Summary summary;
+        in >> summary.frames >> summary.boxes >> summary.labelCounts >> summary.labelConfidenceSum
+           >> summary.confidenceHistogram >> summary.sizeHistogram >> summary.boxesPerFrameHistogram;
+        if (summary.confidenceHistogram.size() != confidenceBins || summary.sizeHistogram.size() != sizeBins
+                || summary.boxesPerFrameHistogram.size() != maxBoxesPerFrame + 1
+                || summary.labelCounts.size() > labelNames.size())
+            break;
+        prefix.push_back(summary);
+    }
+    if (in.status() != QDataStream::Ok || prefix.size() != count) {
+        clear();
+        return false;
+    }
+    for (int i = 0; i < labelNames.size(); ++i)
+        labelIndex.insert(labelNames[i], i);
+    minFrame = first;
+    maxFrame = last;
+    return true;
+}
+
+void AnnotationStats::compute(const AnnotationParser &parser)
+{
+    clear();
+    if (parser.isEmpty())
+        return;
+
+    minFrame = parser.firstFrame();
+    maxFrame = parser.lastFrame();
+    prefix.push_back(Summary());
+    computeBlocks(parser, 0);
+}
+
+void AnnotationStats::update(const AnnotationParser &parser, int fromFrame)
+{
+    if (prefix.isEmpty()) {
+        compute(parser);
+        return;
+    }
+    if (fromFrame < 0 || parser.isEmpty())
+        return;
+
+    // Blocks before the changed one keep their prefix sums
+    int firstBlock = std::min(fromFrame / blockFrames, prefix.size() - 1);
+    prefix.resize(firstBlock + 1);
+    minFrame = parser.firstFrame();
+    maxFrame = parser.lastFrame();
+    computeBlocks(parser, firstBlock);
+}
+
+void AnnotationStats::computeBlocks(const AnnotationParser &parser, int firstBlock)
+{
+    int lastBlock = maxFrame / blockFrames;
+    int blockCount = lastBlock - firstBlock + 1;
+    if (blockCount <= 0)
+        return;
+
+    // Several chunks per core so uneven frames even out. Chunks end on parser
+    // page boundaries, so no page is read by two tasks.
+    const int pageBlocks = std::max(1, AnnotationParser::pageFrames / blockFrames);
+    int firstPage = firstBlock / pageBlocks;
+    int pageCount = lastBlock / pageBlocks - firstPage + 1;
+    int chunkCount = std::min(pageCount, std::max(1, QThread::idealThreadCount() * 4));
+    QVector<Chunk> chunks(chunkCount);
+    for (int i = 0; i < chunkCount; ++i) {
+        int pageBegin = firstPage + static_cast<int>(static_cast<qint64>(pageCount) * i / chunkCount);
+        int pageEnd = firstPage + static_cast<int>(static_cast<qint64>(pageCount) * (i + 1) / chunkCount);
+        chunks[i].firstBlock = std::max(firstBlock, pageBegin * pageBlocks);
+        chunks[i].lastBlock = std::min(lastBlock, pageEnd * pageBlocks - 1);
+    }
+
+    QtConcurrent::blockingMap(chunks, [&parser](Chunk &chunk) {
+        QHash<QString, int> localIndex;
+        auto labelIndexOf = [&](const QString &name) {
+            auto found = localIndex.constFind(name);
+            if (found != localIndex.constEnd())
+                return found.value();
+            int idx = chunk.labels.size();
+            localIndex.insert(name, idx);
+            chunk.labels << name;
+            return idx;
+        };
+
+        chunk.blocks.resize(chunk.lastBlock - chunk.firstBlock + 1);
+        int last = (chunk.lastBlock + 1) * blockFrames - 1;
+        parser.forEachFrame(chunk.firstBlock * blockFrames, last, [&](const FrameAnnotations &frame) {
+            accumulate(chunk.blocks[frame.frameNumber / blockFrames - chunk.firstBlock], frame, labelIndexOf);
+        });
+    });
+
+    // Merge in frame order: map chunk labels to global ones, extend the prefix sums
+    for (const Chunk &chunk : chunks) {
+        QVector<int> remap(chunk.labels.size());
+        for (int i = 0; i < chunk.labels.size(); ++i) {
+            int idx = labelIndex.value(chunk.labels[i], -1);
+            if (idx < 0) {
+                idx = labelNames.size();
+                labelIndex.insert(chunk.labels[i], idx);
+                labelNames << chunk.labels[i];
+            }
+            remap[i] = idx;
+        }
+
+        for (const Summary &block : chunk.blocks) {
+            Summary global = block;
+            global.labelCounts = QVector<qint64>(labelNames.size());
+            global.labelConfidenceSum = QVector<double>(labelNames.size());
+            for (int i = 0; i < block.labelCounts.size(); ++i) {
+                global.labelCounts[remap[i]] = block.labelCounts[i];
+                global.labelConfidenceSum[remap[i]] = block.labelConfidenceSum[i];
+            }
+            Summary next = prefix.last();
+            next.add(global);
+            prefix.push_back(next);
+        }
+    }
+}
+
+void AnnotationStats::scanFrames(const AnnotationParser &parser, int firstFrame, int lastFrame, Summary &summary) const
+{
+    auto labelIndexOf = [this](const QString &name) { return labelIndex.value(name, -1); };
+    parser.forEachFrame(firstFrame, lastFrame, [&](const FrameAnnotations &frame) {
+        accumulate(summary, frame, labelIndexOf);
+    });
+}
+
+AnnotationStats::Summary AnnotationStats::range(const AnnotationParser &parser, int firstFrame, int lastFrame) const
+{
+    Summary summary;
+    firstFrame = std::max(firstFrame, 0);
+    if (prefix.isEmpty() || lastFrame < firstFrame)
+        return summary;
+
+    int blockCount = prefix.size() - 1;
+    int firstFull = (firstFrame + blockFrames - 1) / blockFrames;   // First block fully inside
+    int endFull = (lastFrame + 1) / blockFrames;                     // Blocks before this are inside
+    if (firstFull >= endFull) {
+        // Range within one or two partial blocks
+        scanFrames(parser, firstFrame, lastFrame, summary);
+        return summary;
+    }
+
+    summary = prefix[std::min(endFull, blockCount)];
+    summary.add(prefix[std::min(firstFull, blockCount)], -1);
+    scanFrames(parser, firstFrame, firstFull * blockFrames - 1, summary);
+    scanFrames(parser, endFull * blockFrames, lastFrame, summary);
+    return summary;
+}
+
+AnnotationStats::Summary AnnotationStats::total() const
+{
+    return prefix.isEmpty() ? Summary() : prefix.last();
+}
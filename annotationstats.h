@@ -0,0 +1,67 @@
+#ifndef ANNOTATIONSTATS_H
+#define ANNOTATIONSTATS_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include "annotationparser.h"
+
+class QDataStream;
+
+// Statistics of an annotation run, computed once at load by a parallel
+// reduction over the parser's frames. Counts are kept as prefix sums over
+// blocks of frame numbers, so a frame range is answered from two prefix
+// entries plus at most two partial blocks, without rescanning the run.
+class AnnotationStats
+{
+public:
+    static const int blockFrames = 256;
+    static const int confidenceBins = 20;
+    static const int sizeBins = 20;         // sqrt of box area relative to the frame
+    static const int maxBoxesPerFrame = 32; // Last bin is "this many or more"
+
+    struct Summary {
+        qint64 frames = 0;
+        qint64 boxes = 0;
+        QVector<qint64> labelCounts;            // By label index, see labels()
+        QVector<double> labelConfidenceSum;
+        QVector<qint64> confidenceHistogram;
+        QVector<qint64> sizeHistogram;
+        QVector<qint64> boxesPerFrameHistogram;
+
+        Summary();
+        void add(const Summary &other, int sign = 1);
+    };
+
+    AnnotationStats() {}
+
+    void compute(const AnnotationParser &parser);
+    // Frames from fromFrame on were (re)parsed, recompute only those blocks
+    void update(const AnnotationParser &parser, int fromFrame);
+    void clear();
+
+    // For the video cache; load() leaves the statistics empty if the data does not fit
+    void save(QDataStream &out) const;
+    bool load(QDataStream &in);
+
+    // Inclusive frame range
+    Summary range(const AnnotationParser &parser, int firstFrame, int lastFrame) const;
+    Summary total() const;
+
+    const QStringList &labels() const { return labelNames; }
+    int firstFrame() const { return minFrame; }
+    int lastFrame() const { return maxFrame; }
+
+private:
+    void computeBlocks(const AnnotationParser &parser, int firstBlock);
+    void scanFrames(const AnnotationParser &parser, int firstFrame, int lastFrame, Summary &summary) const;
+
+    QStringList labelNames;
+    QHash<QString, int> labelIndex;
+    QVector<Summary> prefix;    // prefix[b] = sum of blocks before b
+    int minFrame = -1;
+    int maxFrame = -1;
+};
+
+#endif // ANNOTATIONSTATS_H
@@ -1,16 +1,91 @@
 #include "comparewidget.h"
+#include "memorybudget.h"
 #include <QHBoxLayout>
 #include <QVBoxLayout>
 #include <QLineEdit>
 #include <QPushButton>
 #include <QListWidget>
-#include <QTableWidget>
+#include <QTableView>
 #include <QHeaderView>
 #include <QLabel>
 #include <QFileDialog>
 #include <QMessageBox>
 #include <QSet>
+#include <QHash>
 #include <QFileInfo>
+#include <QBrush>
+#include <algorithm>
+#include <limits>
+
+CompareResultModel::CompareResultModel(QObject *parent)
+    : QAbstractTableModel(parent)
+{
+    budgetHandle = MemoryBudget::instance().addConsumer(MemoryBudget::CompareResults);
+}
+
+CompareResultModel::~CompareResultModel()
+{
+    MemoryBudget::instance().removeConsumer(budgetHandle);
+}
+
+int CompareResultModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : rows.size();
+}
+
+int CompareResultModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : 5;
+}
+
+QVariant CompareResultModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() >= rows.size())
+        return QVariant();
+    const Row &row = rows[index.row()];
+    bool both = row.conf1 >= 0 && row.conf2 >= 0;
+    float diff = row.conf2 - row.conf1;
+
+    if (role == Qt::BackgroundRole) {
+        // Highlight improvement or regression
+        if (index.column() != 4 || !both || diff == 0)
+            return QVariant();
+        return QBrush(diff > 0 ? Qt::green : Qt::red);
+    }
+    if (role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (index.column()) {
+    case 0: return QString::number(row.frame);
+    case 1: return labels.value(row.label);
+    case 2: return row.conf1 < 0 ? QString("-") : QString::number(row.conf1, 'f', 2);
+    case 3: return row.conf2 < 0 ? QString("-") : QString::number(row.conf2, 'f', 2);
+    case 4: return both ? (diff >= 0 ? "+" : "") + QString::number(diff, 'f', 2) : QString("-");
+    default: return QVariant();
+    }
+}
+
+QVariant CompareResultModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QAbstractTableModel::headerData(section, orientation, role);
+    static const char *names[] = { "Frame", "Label", "File 1 Confidence", "File 2 Confidence", "Change" };
+    return section >= 0 && section < 5 ? QString(names[section]) : QVariant();
+}
+
+void CompareResultModel::setResults(const QStringList &newLabels, const QVector<Row> &newRows)
+{
+    beginResetModel();
+    labels = newLabels;
+    rows = newRows;
+    endResetModel();
+    MemoryBudget::instance().setUsage(budgetHandle, rows.capacity() * qint64(sizeof(Row)));
+}
+
+void CompareResultModel::clear()
+{
+    setResults(QStringList(), QVector<Row>());
+}
 
 CompareWidget::CompareWidget(QWidget *parent)
     : QWidget(parent)
@@ -23,7 +98,9 @@ CompareWidget::CompareWidget(QWidget *parent)
     labelListWidget = new QListWidget(this);
     labelListWidget->setSelectionMode(QAbstractItemView::MultiSelection);
     compareButton = new QPushButton("Compare", this);
-    resultTable = new QTableWidget(this);
+    resultModel = new CompareResultModel(this);
+    resultTable = new QTableView(this);
+    resultTable->setModel(resultModel);
     statusLabel = new QLabel(this);
 
     // Layouts
@@ -53,10 +130,8 @@ CompareWidget::CompareWidget(QWidget *parent)
     setLayout(mainLayout);
 
     // Table setup
-    resultTable->setColumnCount(5);
-    QStringList headers = {"Frame", "Label", "File 1 Confidence", "File 2 Confidence", "Change"};
-    resultTable->setHorizontalHeaderLabels(headers);
     resultTable->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    resultTable->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
 
     statusLabel->setText("Select files and labels to compare.");
 
@@ -74,7 +149,7 @@ CompareWidget::CompareWidget(QWidget *parent)
 
 void CompareWidget::browseFile1()
 {
-    QString fn = QFileDialog::getOpenFileName(this, "Select annotation file 1", QString(), "Text Files (*.txt)");
+    QString fn = QFileDialog::getOpenFileName(this, "Select annotation file 1", QString(), "Annotation Files (*.txt *.qann)");
     if (!fn.isEmpty()) {
         fileEdit1->setText(fn);
         loadFiles();
@@ -83,7 +158,7 @@ void CompareWidget::browseFile1()
 
 void CompareWidget::browseFile2()
 {
-    QString fn = QFileDialog::getOpenFileName(this, "Select annotation file 2", QString(), "Text Files (*.txt)");
+    QString fn = QFileDialog::getOpenFileName(this, "Select annotation file 2", QString(), "Annotation Files (*.txt *.qann)");
     if (!fn.isEmpty()) {
         fileEdit2->setText(fn);
         loadFiles();
@@ -100,6 +175,7 @@ void CompareWidget::loadFiles()
 
     file1Loaded = ok1;
     file2Loaded = ok2;
+    resultModel->clear();
 
     if (ok1 && ok2) {
         statusLabel->setText("Both files loaded. Select labels and press Compare.");
@@ -119,16 +195,13 @@ void CompareWidget::populateLabelSelection()
     labelListWidget->clear();
 
     // Collect all labels from both files
-    for (const auto &frame : parser1.frameMap) {
+    auto collect = [this](const FrameAnnotations &frame) {
         for (const FrameLabel &fl : frame.labels) {
             allLabels.insert(fl.label);
         }
-    }
-    for (const auto &frame : parser2.frameMap) {
-        for (const FrameLabel &fl : frame.labels) {
-            allLabels.insert(fl.label);
-        }
-    }
+    };
+    parser1.forEachFrame(collect);
+    parser2.forEachFrame(collect);
     // Fill list widget
     for (const QString &label : allLabels) {
         QListWidgetItem *item = new QListWidgetItem(label, labelListWidget);
@@ -154,73 +227,82 @@ void CompareWidget::onCompare()
         return;
     }
 
-    // Find all frame numbers in either file
-    QSet<int> allFrames;
-    for (auto it = parser1.frameMap.begin(); it != parser1.frameMap.end(); ++it)
-        allFrames.insert(it.key());
-    for (auto it = parser2.frameMap.begin(); it != parser2.frameMap.end(); ++it)
-        allFrames.insert(it.key());
-
-    QList<int> frameList = allFrames.values();
-    std::sort(frameList.begin(), frameList.end());
-
-    resultTable->setRowCount(0);
-
-    int nRows = 0;
-    for (int frameNum : frameList) {
-        // For each selected label
-        for (const QString &label : selectedLabels) {
-            // Get highest confidence per file
-            float conf1 = -1.0f, conf2 = -1.0f;
-            const FrameAnnotations* ann1 = parser1.getAnnotations(frameNum);
-            if (ann1) {
-                for (const FrameLabel &fl : ann1->labels) {
-                    if (fl.label == label)
-                        conf1 = std::max(conf1, fl.confidence);
+    QStringList labels = selectedLabels.values();
+    labels.sort();
+    QHash<QString, int> labelIds;
+    for (int i = 0; i < labels.size(); ++i)
+        labelIds.insert(labels[i], i);
+
+    // Rows are capped by what is left of the memory budget
+    qint64 maxRows = std::min<qint64>(std::numeric_limits<int>::max() / 2,
+                                      std::max<qint64>(100000, MemoryBudget::instance().available() / qint64(sizeof(CompareResultModel::Row))));
+    QVector<CompareResultModel::Row> rows;
+    bool truncated = false;
+    int compared = 0;
+
+    // Both files are walked one page of frames at a time, so only a page of each is held
+    int first = parser1.isEmpty() ? parser2.firstFrame()
+              : parser2.isEmpty() ? parser1.firstFrame() : std::min(parser1.firstFrame(), parser2.firstFrame());
+    int last = std::max(parser1.lastFrame(), parser2.lastFrame());
+    const int step = AnnotationParser::pageFrames;
+    for (qint64 begin = std::max(first, 0); first >= 0 && begin <= last && !truncated; begin += step) {
+        int end = static_cast<int>(std::min<qint64>(begin + step - 1, last));
+        // Highest confidence per selected label, per file
+        QMap<int, QVector<float>> conf1, conf2;
+        auto collect = [&](QMap<int, QVector<float>> &conf) {
+            return [&](const FrameAnnotations &frame) {
+                QVector<float> best(labels.size(), -1.0f);
+                bool any = false;
+                for (const FrameLabel &fl : frame.labels) {
+                    int id = labelIds.value(fl.label, -1);
+                    if (id >= 0) {
+                        best[id] = std::max(best[id], fl.confidence);
+                        any = true;
+                    }
                 }
-            }
-            const FrameAnnotations* ann2 = parser2.getAnnotations(frameNum);
-            if (ann2) {
-                for (const FrameLabel &fl : ann2->labels) {
-                    if (fl.label == label)
-                        conf2 = std::max(conf2, fl.confidence);
+                if (any)
+                    conf.insert(frame.frameNumber, best);
+            };
+        };
+        parser1.forEachFrame(static_cast<int>(begin), end, collect(conf1));
+        parser2.forEachFrame(static_cast<int>(begin), end, collect(conf2));
+
+        QSet<int> frames;
+        for (auto it = conf1.constBegin(); it != conf1.constEnd(); ++it)
+            frames.insert(it.key());
+        for (auto it = conf2.constBegin(); it != conf2.constEnd(); ++it)
+            frames.insert(it.key());
+        QList<int> frameList = frames.values();
+        std::sort(frameList.begin(), frameList.end());
+
+        for (int frameNum : frameList) {
+            QVector<float> c1 = conf1.value(frameNum);
+            QVector<float> c2 = conf2.value(frameNum);
+            for (int label = 0; label < labels.size(); ++label) {
+                CompareResultModel::Row row;
+                row.frame = frameNum;
+                row.label = static_cast<quint16>(label);
+                row.conf1 = c1.isEmpty() ? -1.0f : c1[label];
+                row.conf2 = c2.isEmpty() ? -1.0f : c2[label];
+                // If neither file has that label in this frame, skip
+                if (row.conf1 < 0 && row.conf2 < 0)
+                    continue;
+                if (rows.size() >= maxRows) {
+                    truncated = true;
+                    break;
                 }
+                rows.push_back(row);
             }
-            // If neither file has that label in this frame, skip
-            if (conf1 < 0 && conf2 < 0)
-                continue;
-            // Show row
-            resultTable->insertRow(nRows);
-
-            QTableWidgetItem *frameItem = new QTableWidgetItem(QString::number(frameNum));
-            QTableWidgetItem *labelItem = new QTableWidgetItem(label);
-            QTableWidgetItem *conf1Item = new QTableWidgetItem(conf1 < 0 ? "-" : QString::number(conf1, 'f', 2));
-            QTableWidgetItem *conf2Item = new QTableWidgetItem(conf2 < 0 ? "-" : QString::number(conf2, 'f', 2));
-            float diff = 0.0f;
-            QString diffStr = "-";
-            if (conf1 >= 0 && conf2 >= 0) {
-                diff = conf2 - conf1;
-                diffStr = (diff >= 0 ? "+" : "") + QString::number(diff, 'f', 2);
-            }
-            QTableWidgetItem *diffItem = new QTableWidgetItem(diffStr);
-
-            // Highlight improvement or regression
-            if (conf1 >= 0 && conf2 >= 0) {
-                if (diff > 0)
-                    diffItem->setBackground(Qt::green);
-                else if (diff < 0)
-                    diffItem->setBackground(Qt::red);
-            }
-
-            resultTable->setItem(nRows, 0, frameItem);
-            resultTable->setItem(nRows, 1, labelItem);
-            resultTable->setItem(nRows, 2, conf1Item);
-            resultTable->setItem(nRows, 3, conf2Item);
-            resultTable->setItem(nRows, 4, diffItem);
-            ++nRows;
+            if (truncated)
+                break;
+            ++compared;
         }
     }
-    statusLabel->setText(QString("Compared %1 frames.").arg(nRows));
-}
-
 
+    rows.squeeze();
+    resultModel->setResults(labels, rows);
+    if (truncated)
+        statusLabel->setText(QString("Memory budget reached: showing the first %1 rows (%2 frames).").arg(rows.size()).arg(compared));
+    else
+        statusLabel->setText(QString("Compared %1 frames.").arg(rows.size()));
+}
@@ -5,14 +5,48 @@
 #include <QMap>
 #include <QSet>
 #include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QAbstractTableModel>
 #include "annotationparser.h"
 
 class QLineEdit;
 class QPushButton;
 class QListWidget;
-class QTableWidget;
+class QTableView;
 class QLabel;
 
+// Compare rows kept as plain values and formatted when the view asks,
+// so a long run costs 16 bytes per row instead of five table items.
+class CompareResultModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    struct Row {
+        int frame;
+        quint16 label;      // Index into the model's labels
+        float conf1;        // -1 when the file has no such box
+        float conf2;
+    };
+
+    explicit CompareResultModel(QObject *parent = nullptr);
+    ~CompareResultModel();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    void setResults(const QStringList &labels, const QVector<Row> &rows);
+    void clear();
+
+private:
+    QStringList labels;
+    QVector<Row> rows;
+    int budgetHandle;
+};
+
 class CompareWidget : public QWidget
 {
     Q_OBJECT
@@ -38,7 +72,8 @@ private:
     QPushButton *browseButton2;
     QListWidget *labelListWidget;
     QPushButton *compareButton;
-    QTableWidget *resultTable;
+    CompareResultModel *resultModel;
+    QTableView *resultTable;
     QLabel *statusLabel;
     QPushButton *endButton;           // <-- Add this
 
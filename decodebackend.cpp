@@ -0,0 +1,171 @@
+#include "decodebackend.h"
+#ifdef HAVE_FFMPEG
+#include "ffmpegbackend.h"
+#endif
+#include <QtGlobal>
+
+namespace {
+
+// Frames to grab() forward instead of seeking; seeking restarts at the
+// previous keyframe, so short gaps are cheaper to decode through.
+const int maxGrabGap = 30;
+
+} // namespace
+
+std::unique_ptr<DecodeBackend> DecodeBackend::create(Kind kind)
+{
+    if (kind == Auto)
+        kind = qgetenv("QTOPENCV_DECODER") == "opencv" || !isAvailable(Ffmpeg) ? OpenCv : Ffmpeg;
+
+#ifdef HAVE_FFMPEG
+    if (kind == Ffmpeg)
+        return std::unique_ptr<DecodeBackend>(new FfmpegBackend);
+#endif
+    return std::unique_ptr<DecodeBackend>(new OpenCvBackend);
+}
+
+std::unique_ptr<DecodeBackend> DecodeBackend::openFile(const QString &filePath, PixelFormat format,
+                                                       int threadCount, Kind kind)
+{
+    std::unique_ptr<DecodeBackend> decoder = create(kind);
+    decoder->setOutputFormat(format);
+    decoder->setThreadCount(threadCount);
+    if (decoder->open(filePath) || dynamic_cast<OpenCvBackend*>(decoder.get()))
+        return decoder;
+
+    // OpenCV as fallback for files the direct backend can't handle
+    decoder.reset(new OpenCvBackend);
+    decoder->setOutputFormat(format);
+    decoder->setThreadCount(threadCount);
+    decoder->open(filePath);
+    return decoder;
+}
+
+bool DecodeBackend::isAvailable(Kind kind)
+{
+#ifdef HAVE_FFMPEG
+    Q_UNUSED(kind);
+    return true;
+#else
+    return kind != Ffmpeg;
+#endif
+}
+
+bool DecodeBackend::seek(int frameIdx)
+{
+    if (!isOpened())
+        return false;
+    nextIdx = doSeek(frameIdx) ? frameIdx : -1;
+    return nextIdx == frameIdx;
+}
+
+bool DecodeBackend::grab()
+{
+    if (!doGrab()) {
+        nextIdx = -1;
+        return false;
+    }
+    if (nextIdx >= 0)
+        ++nextIdx;
+    return true;
+}
+
+bool DecodeBackend::read(cv::Mat &frame)
+{
+    if (!doRead(frame) || frame.empty()) {
+        nextIdx = -1;
+        return false;
+    }
+    if (nextIdx >= 0)
+        ++nextIdx;
+    return true;
+}
+
+bool DecodeBackend::skipTo(int frameIdx)
+{
+    if (nextIdx < 0 || frameIdx < nextIdx || frameIdx - nextIdx > maxGrabGap)
+        return seek(frameIdx);
+    while (nextIdx >= 0 && nextIdx < frameIdx)
+        grab();
+    return nextIdx == frameIdx;
+}
+
+bool DecodeBackend::readFrame(int frameIdx, cv::Mat &frame)
+{
+    return skipTo(frameIdx) && read(frame);
+}
+
+QSize DecodeBackend::scaledSize(QSize native) const
+{
+    if (!outputSize.isValid() || outputSize.isEmpty())
+        return native;
+    QSize size = native.scaled(outputSize, Qt::KeepAspectRatio);
+    return size.isEmpty() ? native : size;
+}
+
+bool OpenCvBackend::open(const QString &filePath)
+{
+    close();
+    cap.open(filePath.toStdString());
+    nextIdx = cap.isOpened() ? 0 : -1;
+    return cap.isOpened();
+}
+
+void OpenCvBackend::close()
+{
+    if (cap.isOpened())
+        cap.release();
+    nextIdx = -1;
+}
+
+bool OpenCvBackend::isOpened() const
+{
+    return cap.isOpened();
+}
+
+double OpenCvBackend::fps() const
+{
+    return cap.get(cv::CAP_PROP_FPS);
+}
+
+int OpenCvBackend::frameCount() const
+{
+    return static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+}
+
+QSize OpenCvBackend::frameSize() const
+{
+    return QSize(static_cast<int>(cap.get(cv::CAP_PROP_FRAME_WIDTH)),
+                 static_cast<int>(cap.get(cv::CAP_PROP_FRAME_HEIGHT)));
+}
+
+bool OpenCvBackend::doSeek(int frameIdx)
+{
+    return cap.set(cv::CAP_PROP_POS_FRAMES, frameIdx);
+}
+
+bool OpenCvBackend::doGrab()
+{
+    return cap.grab();
+}
+
+bool OpenCvBackend::doRead(cv::Mat &frame)
+{
+    cv::Mat decoded;
+    if (!cap.read(decoded) || decoded.empty())
+        return false;
+
+    // OpenCV always gives full size BGR, scale first so the conversion is cheaper
+    QSize size = scaledSize(QSize(decoded.cols, decoded.rows));
+    if (size != QSize(decoded.cols, decoded.rows)) {
+        int interpolation = size.width() < decoded.cols ? cv::INTER_AREA : cv::INTER_LINEAR;
+        cv::Mat scaled;
+        cv::resize(decoded, scaled, cv::Size(size.width(), size.height()), 0, 0, interpolation);
+        decoded = scaled;
+    }
+    if (outputFormat == RGB)
+        cv::cvtColor(decoded, frame, cv::COLOR_BGR2RGB);
+    else
+        frame = decoded;
+    return true;
+}
@@ -0,0 +1,86 @@
+#ifndef DECODEBACKEND_H
+#define DECODEBACKEND_H
+
+#include <QString>
+#include <QSize>
+#include <memory>
+#include <opencv2/opencv.hpp>
+
+// Video decoder used by VideoWidget and the grid panes. Frames come out in
+// the requested pixel format and, if an output size is set, already scaled
+// to fit it. Keeps track of the frame index the next read returns, so
+// sequential reads never seek.
+class DecodeBackend
+{
+public:
+    enum Kind { Auto, OpenCv, Ffmpeg };
+    enum PixelFormat { BGR, RGB };
+
+    virtual ~DecodeBackend() {}
+
+    // Auto picks FFmpeg when built in, unless QTOPENCV_DECODER=opencv is set
+    static std::unique_ptr<DecodeBackend> create(Kind kind = Auto);
+    // Opens with the best backend, falling back to OpenCV if it can't open the file
+    static std::unique_ptr<DecodeBackend> openFile(const QString &filePath, PixelFormat format,
+                                                   int threadCount = 0, Kind kind = Auto);
+    static bool isAvailable(Kind kind);
+
+    virtual const char *name() const = 0;
+    virtual bool open(const QString &filePath) = 0;
+    virtual void close() = 0;
+    virtual bool isOpened() const = 0;
+    virtual double fps() const = 0;
+    virtual int frameCount() const = 0;
+    virtual QSize frameSize() const = 0;
+
+    // Decoder threads, 0 = backend default. Takes effect on open().
+    void setThreadCount(int count) { threadCount = count; }
+    void setOutputFormat(PixelFormat format) { outputFormat = format; }
+    // Frames are scaled to fit inside size (keeping aspect), invalid = native
+    void setOutputSize(QSize size) { outputSize = size; }
+    PixelFormat format() const { return outputFormat; }
+
+    // Accurate seek, the next read()/grab() returns frameIdx
+    bool seek(int frameIdx);
+    // Decodes the next frame without converting it
+    bool grab();
+    bool read(cv::Mat &frame);
+    // Positions so the next read returns frameIdx, decoding through short gaps
+    bool skipTo(int frameIdx);
+    bool readFrame(int frameIdx, cv::Mat &frame);
+    int nextFrameIndex() const { return nextIdx; }
+
+protected:
+    virtual bool doSeek(int frameIdx) = 0;
+    virtual bool doGrab() = 0;
+    virtual bool doRead(cv::Mat &frame) = 0;
+    // Output size for a frame of size native
+    QSize scaledSize(QSize native) const;
+
+    int threadCount = 0;
+    PixelFormat outputFormat = BGR;
+    QSize outputSize;
+    int nextIdx = -1;   // Frame the next read returns, -1 = unknown
+};
+
+class OpenCvBackend : public DecodeBackend
+{
+public:
+    const char *name() const override { return "OpenCV"; }
+    bool open(const QString &filePath) override;
+    void close() override;
+    bool isOpened() const override;
+    double fps() const override;
+    int frameCount() const override;
+    QSize frameSize() const override;
+
+protected:
+    bool doSeek(int frameIdx) override;
+    bool doGrab() override;
+    bool doRead(cv::Mat &frame) override;
+
+private:
+    cv::VideoCapture cap;
+};
+
+#endif // DECODEBACKEND_H
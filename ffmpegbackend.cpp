@@ -0,0 +1,236 @@
+#include "ffmpegbackend.h"
+#include <algorithm>
+
+namespace {
+
+// Seeks that land past the target are retried from further back, this many times
+const int maxSeekAttempts = 4;
+
+} // namespace
+
+FfmpegBackend::~FfmpegBackend()
+{
+    close();
+}
+
+bool FfmpegBackend::open(const QString &filePath)
+{
+    close();
+
+    if (avformat_open_input(&formatCtx, filePath.toUtf8().constData(), nullptr, nullptr) < 0) {
+        formatCtx = nullptr;
+        return false;
+    }
+    if (avformat_find_stream_info(formatCtx, nullptr) < 0) {
+        close();
+        return false;
+    }
+    streamIdx = av_find_best_stream(formatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    if (streamIdx < 0) {
+        close();
+        return false;
+    }
+    AVStream *stream = formatCtx->streams[streamIdx];
+    const AVCodec *codec = avcodec_find_decoder(stream->codecpar->codec_id);
+    if (!codec) {
+        close();
+        return false;
+    }
+    codecCtx = avcodec_alloc_context3(codec);
+    if (!codecCtx || avcodec_parameters_to_context(codecCtx, stream->codecpar) < 0) {
+        close();
+        return false;
+    }
+    // 0 lets libavcodec use one thread per core
+    codecCtx->thread_count = threadCount;
+    codecCtx->thread_type = FF_THREAD_FRAME | FF_THREAD_SLICE;
+    if (avcodec_open2(codecCtx, codec, nullptr) < 0) {
+        close();
+        return false;
+    }
+
+    timeBase = stream->time_base;
+    frameRate = av_guess_frame_rate(formatCtx, stream, nullptr);
+    if (frameRate.num <= 0 || frameRate.den <= 0)
+        frameRate = AVRational{30, 1};
+    startPts = stream->start_time != AV_NOPTS_VALUE ? stream->start_time : 0;
+    if (stream->nb_frames > 0)
+        frames = static_cast<int>(stream->nb_frames);
+    else if (stream->duration != AV_NOPTS_VALUE)
+        frames = static_cast<int>(av_rescale_q(stream->duration, timeBase, av_inv_q(frameRate)));
+    else if (formatCtx->duration > 0)
+        frames = static_cast<int>(formatCtx->duration * av_q2d(frameRate) / AV_TIME_BASE);
+
+    decoded = av_frame_alloc();
+    packet = av_packet_alloc();
+    if (!decoded || !packet) {
+        close();
+        return false;
+    }
+    draining = false;
+    havePending = false;
+    nextIdx = 0;
+    return true;
+}
+
+void FfmpegBackend::close()
+{
+    sws_freeContext(swsCtx);
+    swsCtx = nullptr;
+    av_frame_free(&decoded);
+    av_packet_free(&packet);
+    avcodec_free_context(&codecCtx);
+    avformat_close_input(&formatCtx);
+    streamIdx = -1;
+    frames = 0;
+    draining = false;
+    havePending = false;
+    nextIdx = -1;
+}
+
+bool FfmpegBackend::isOpened() const
+{
+    return codecCtx != nullptr;
+}
+
+double FfmpegBackend::fps() const
+{
+    return av_q2d(frameRate);
+}
+
+int FfmpegBackend::frameCount() const
+{
+    return frames;
+}
+
+QSize FfmpegBackend::frameSize() const
+{
+    return codecCtx ? QSize(codecCtx->width, codecCtx->height) : QSize();
+}
+
+bool FfmpegBackend::decodeNext()
+{
+    while (true) {
+        int ret = avcodec_receive_frame(codecCtx, decoded);
+        if (ret == 0)
+            return true;
+        if (ret != AVERROR(EAGAIN) || draining)
+            return false;
+
+        // Decoder wants more input
+        ret = av_read_frame(formatCtx, packet);
+        if (ret == AVERROR(EAGAIN))
+            continue;
+        if (ret == AVERROR_EOF) {
+            // End of file: flush the frames still held by the decoder threads
+            draining = true;
+            if (avcodec_send_packet(codecCtx, nullptr) < 0)
+                return false;
+            continue;
+        }
+        if (ret < 0)
+            return false;   // Read error
+        if (packet->stream_index == streamIdx)
+            ret = avcodec_send_packet(codecCtx, packet);
+        else
+            ret = 0;
+        av_packet_unref(packet);
+        // A corrupt packet is skipped, anything else stops decoding
+        if (ret < 0 && ret != AVERROR_INVALIDDATA)
+            return false;
+    }
+}
+
+int FfmpegBackend::frameIndexOf(const AVFrame *frame) const
+{
+    int64_t pts = frame->best_effort_timestamp;
+    if (pts == AV_NOPTS_VALUE)
+        pts = frame->pts;
+    if (pts == AV_NOPTS_VALUE)
+        return -1;
+    return static_cast<int>(av_rescale_q(pts - startPts, timeBase, av_inv_q(frameRate)));
+}
+
+bool FfmpegBackend::doSeek(int frameIdx)
+{
+    // Seek to the keyframe before the target, then decode up to the exact frame by PTS.
+    // The first frame after a seek can be past the target (inexact keyframe index);
+    // then seek again from further back, starting one second before and doubling.
+    // Frames without timestamps are counted from the start of the file.
+    int backoff = 0;
+    for (int attempt = 0; attempt < maxSeekAttempts; ++attempt) {
+        int seekIdx = std::max(0, frameIdx - backoff);
+        int64_t target = startPts + av_rescale_q(seekIdx, av_inv_q(frameRate), timeBase);
+        if (av_seek_frame(formatCtx, streamIdx, target, AVSEEK_FLAG_BACKWARD) < 0)
+            return false;
+        avcodec_flush_buffers(codecCtx);
+        draining = false;
+        havePending = false;
+
+        int idx = -1;
+        bool decodedAny = false;
+        while (decodeNext()) {
+            decodedAny = true;
+            idx = frameIndexOf(decoded);
+            if (idx < 0 || idx >= frameIdx)
+                break;
+        }
+        if (!decodedAny || (idx >= 0 && idx < frameIdx))
+            return false;   // Ran out of frames before the target
+        if (idx < 0) {
+            // No timestamps: only the start of the file is a known index, count frames from there
+            if (seekIdx > 0) {
+                backoff = frameIdx;
+                continue;
+            }
+            for (int i = 0; i < frameIdx; ++i) {
+                if (!decodeNext())
+                    return false;
+            }
+            havePending = true;
+            return true;
+        }
+        if (idx == frameIdx) {
+            havePending = true;
+            return true;
+        }
+        if (seekIdx == 0)
+            return false;   // Past the target from the start of the file: no such frame
+        backoff = backoff == 0 ? std::max(1, static_cast<int>(av_q2d(frameRate) + 0.5)) : 2 * backoff;
+    }
+    return false;
+}
+
+bool FfmpegBackend::doGrab()
+{
+    if (havePending) {
+        havePending = false;
+        return true;
+    }
+    return decodeNext();
+}
+
+bool FfmpegBackend::doRead(cv::Mat &frame)
+{
+    if (!havePending && !decodeNext())
+        return false;
+    havePending = false;
+
+    // swscale converts and scales in one pass, straight into the output Mat
+    int width = decoded->width;
+    int height = decoded->height;
+    QSize size = scaledSize(QSize(width, height));
+    AVPixelFormat dstFormat = outputFormat == RGB ? AV_PIX_FMT_RGB24 : AV_PIX_FMT_BGR24;
+    int flags = size.width() < width ? SWS_AREA : SWS_BILINEAR;
+    swsCtx = sws_getCachedContext(swsCtx, width, height, static_cast<AVPixelFormat>(decoded->format),
+                                  size.width(), size.height(), dstFormat, flags,
+                                  nullptr, nullptr, nullptr);
+    if (!swsCtx)
+        return false;
+
+    frame.create(size.height(), size.width(), CV_8UC3);
+    uint8_t *dstData[4] = { frame.data, nullptr, nullptr, nullptr };
+    int dstLinesize[4] = { static_cast<int>(frame.step), 0, 0, 0 };
+    sws_scale(swsCtx, decoded->data, decoded->linesize, 0, height, dstData, dstLinesize);
+    return true;
+}
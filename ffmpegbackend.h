@@ -0,0 +1,52 @@
+#ifndef FFMPEGBACKEND_H
+#define FFMPEGBACKEND_H
+
+#include "decodebackend.h"
+
+extern "C" {
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+#include <libswscale/swscale.h>
+}
+
+// Direct libav* decoder: frame and slice threaded decoding, seeking by PTS
+// to the exact frame, and swscale writing straight into the output size
+// and pixel format.
+class FfmpegBackend : public DecodeBackend
+{
+public:
+    FfmpegBackend() {}
+    ~FfmpegBackend() override;
+
+    const char *name() const override { return "FFmpeg"; }
+    bool open(const QString &filePath) override;
+    void close() override;
+    bool isOpened() const override;
+    double fps() const override;
+    int frameCount() const override;
+    QSize frameSize() const override;
+
+protected:
+    bool doSeek(int frameIdx) override;
+    bool doGrab() override;
+    bool doRead(cv::Mat &frame) override;
+
+private:
+    bool decodeNext();
+    int frameIndexOf(const AVFrame *frame) const;
+
+    AVFormatContext *formatCtx = nullptr;
+    AVCodecContext *codecCtx = nullptr;
+    AVFrame *decoded = nullptr;
+    AVPacket *packet = nullptr;
+    SwsContext *swsCtx = nullptr;
+    int streamIdx = -1;
+    AVRational timeBase = {0, 1};
+    AVRational frameRate = {0, 1};
+    int64_t startPts = 0;
+    int frames = 0;
+    bool draining = false;      // Sent the flush packet, only buffered frames are left
+    bool havePending = false;   // decoded holds the frame the next read returns (after seek)
+};
+
+#endif // FFMPEGBACKEND_H
@@ -1,10 +1,75 @@
 #include "mainwindow.h"
+#include "decodebackend.h"
+#include "memorybudget.h"
 #include <QApplication>
+#include <QStringList>
+#include <QElapsedTimer>
+#include <QThread>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+// QtOpencv --bench-decode file.mp4 [frames]
+// Sequential decode rate and seek time for every available decode backend.
+static int benchmarkDecode(const QString &filePath, int frames)
+{
+    struct Run { DecodeBackend::Kind kind; int threads; };
+    const Run runs[] = {
+        { DecodeBackend::OpenCv, 0 },
+        { DecodeBackend::Ffmpeg, 1 },
+        { DecodeBackend::Ffmpeg, QThread::idealThreadCount() },
+    };
+    const int seeks = 20;
+
+    for (const Run &run : runs) {
+        if (!DecodeBackend::isAvailable(run.kind))
+            continue;
+        std::unique_ptr<DecodeBackend> decoder = DecodeBackend::create(run.kind);
+        decoder->setOutputFormat(DecodeBackend::RGB);
+        decoder->setThreadCount(run.threads);
+        if (!decoder->open(filePath)) {
+            std::printf("%s: failed to open %s\n", decoder->name(), qPrintable(filePath));
+            continue;
+        }
+
+        QElapsedTimer timer;
+        timer.start();
+        cv::Mat frame;
+        int decoded = 0;
+        while (decoded < frames && decoder->read(frame))
+            ++decoded;
+        double sequentialFps = decoded * 1000.0 / std::max<qint64>(1, timer.elapsed());
+
+        // Seeks spread over the whole file
+        int total = decoder->frameCount();
+        timer.restart();
+        for (int i = 0; i < seeks; ++i)
+            decoder->readFrame(static_cast<int>(static_cast<qint64>(total) * (2 * i + 1) / (2 * seeks)), frame);
+        double msPerSeek = timer.elapsed() / static_cast<double>(seeks);
+
+        QSize size = decoder->frameSize();
+        std::printf("%-7s threads=%-3s %dx%d  sequential: %7.1f fps (%d frames)  seek: %6.1f ms\n",
+                    decoder->name(),
+                    run.threads > 0 ? qPrintable(QString::number(run.threads)) : "def",
+                    size.width(), size.height(), sequentialFps, decoded, msPerSeek);
+    }
+    return 0;
+}
 
 int main(int argc, char *argv[])
 {
+    if (argc >= 3 && std::strcmp(argv[1], "--bench-decode") == 0)
+        return benchmarkDecode(QString::fromLocal8Bit(argv[2]), argc >= 4 ? std::atoi(argv[3]) : 500);
+
     QApplication a(argc, argv);
+    // QtOpencv --memory-budget <MB>: caches and annotation pages are kept under this
+    QStringList args = a.arguments();
+    int budgetArg = args.indexOf("--memory-budget");
+    if (budgetArg > 0 && budgetArg + 1 < args.size() && args[budgetArg + 1].toLongLong() > 0)
+        MemoryBudget::instance().setBudget(args[budgetArg + 1].toLongLong() * 1024 * 1024);
+
     MainWindow w;
     w.show();
     return a.exec();
-}
\ No newline at end of file
+}
@@ -1,6 +1,12 @@
 #include "mainwindow.h"
 #include "videowidget.h"
 #include "comparewidget.h" // <-- Add this include
+#include "syncgridwidget.h"
+#include "statswidget.h"
+#include "trackwidget.h"
+#include "overlayfilterwidget.h"
+#include "annotationoverlay.h"
+#include "memorybudget.h"
 #include <QMenuBar>
 #include <QStatusBar>
 #include <QFileDialog>
@@ -8,6 +14,9 @@
 #include <QKeyEvent>
 #include <QFileInfo>
 #include <QLabel>        // <-- THIS LINE IS NEEDED
+#include <QPainter>
+#include <QDockWidget>
+#include <QTimer>
 
 
 MainWindow::MainWindow(QWidget *parent)
@@ -32,19 +41,53 @@ MainWindow::MainWindow(QWidget *parent)
 
     //QAction *compareAction = fileMenu->addAction("&Compare Annotation Files...");
     //connect(compareAction, &QAction::triggered, this, &MainWindow::showCompareDialog); // <-- Add this
+    QAction *exportAction = fileMenu->addAction("&Export Annotations...");
+    connect(exportAction, &QAction::triggered, this, &MainWindow::exportAnnotations);
+
     QAction *compareAction = fileMenu->addAction("&Compare Annotation Files...");
     connect(compareAction, &QAction::triggered, this, &MainWindow::showCompareWindow);
 
+    QAction *gridAction = fileMenu->addAction("Open &Grid...");
+    connect(gridAction, &QAction::triggered, this, &MainWindow::showGridWindow);
+
+    QAction *statsAction = fileMenu->addAction("Annotation &Statistics...");
+    connect(statsAction, &QAction::triggered, this, &MainWindow::showStatsWindow);
+
+    QAction *tracksAction = fileMenu->addAction("&Tracks...");
+    connect(tracksAction, &QAction::triggered, this, &MainWindow::showTracksWindow);
+
     fileMenu->addSeparator();
     fileMenu->addAction("E&xit", this, SLOT(close()));
 
     statusBar()->showMessage("Stopped");
+    rateLabel = new QLabel("1x", this);
+    statusBar()->addPermanentWidget(rateLabel);
+    memoryLabel = new QLabel(this);
+    statusBar()->addPermanentWidget(memoryLabel);
+    annotationOrderLabel = new QLabel("Annotations out of order", this);
+    annotationOrderLabel->setToolTip("Frame numbers in the annotation file go back, pages are read from several places and sorted");
+    statusBar()->addPermanentWidget(annotationOrderLabel);
+    annotationOrderLabel->hide();
+    QTimer *memoryTimer = new QTimer(this);
+    connect(memoryTimer, &QTimer::timeout, this, &MainWindow::showMemoryUsage);
+    memoryTimer->start(1000);
+    showMemoryUsage();
 
     videoWidget = new VideoWidget(this);
     setCentralWidget(videoWidget);
     connect(videoWidget, &VideoWidget::playStateChanged, this, &MainWindow::updateStatusBar);
     connect(videoWidget, &VideoWidget::frameInfoChanged, this, &MainWindow::showFrameInfo);
     connect(videoWidget, &VideoWidget::frameSaved, this, &MainWindow::showFrameSaved);
+    connect(videoWidget, &VideoWidget::playbackRateChanged, this, &MainWindow::showPlaybackRate);
+    connect(videoWidget, &VideoWidget::annotationsChanged, this, &MainWindow::showAnnotationOrder);
+
+    // Overlay filters beside the video, toggled from the View menu
+    QDockWidget *filterDock = new QDockWidget("Overlay Filter", this);
+    filterDock->setWidget(new OverlayFilterWidget(videoWidget, filterDock));
+    addDockWidget(Qt::RightDockWidgetArea, filterDock);
+    filterDock->hide();
+    QMenu *viewMenu = menuBar()->addMenu("&View");
+    viewMenu->addAction(filterDock->toggleViewAction());
 }
 
 MainWindow::~MainWindow()
@@ -72,6 +115,45 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
         videoWidget->nextFrame();
         event->accept();
         break;
+    case Qt::Key_L:
+        // Forward; pressed again while playing forward doubles the speed
+        if (videoWidget->isPlaying() && !videoWidget->isReverse()) {
+            videoWidget->setPlaybackRate(videoWidget->playbackRate() * 2);
+        } else {
+            videoWidget->setReverse(false);
+            videoWidget->setPlaybackRate(1.0);
+            videoWidget->play();
+        }
+        event->accept();
+        break;
+    case Qt::Key_J:
+        // Reverse; pressed again while playing reverse doubles the speed
+        if (videoWidget->isPlaying() && videoWidget->isReverse()) {
+            videoWidget->setPlaybackRate(videoWidget->playbackRate() * 2);
+        } else {
+            videoWidget->setReverse(true);
+            videoWidget->setPlaybackRate(1.0);
+            videoWidget->play();
+        }
+        event->accept();
+        break;
+    case Qt::Key_Escape:
+        videoWidget->stopTrack();
+        event->accept();
+        break;
+    case Qt::Key_K:
+        videoWidget->pause();
+        videoWidget->setPlaybackRate(1.0);
+        event->accept();
+        break;
+    case Qt::Key_BracketLeft:
+        videoWidget->setPlaybackRate(videoWidget->playbackRate() / 2);
+        event->accept();
+        break;
+    case Qt::Key_BracketRight:
+        videoWidget->setPlaybackRate(videoWidget->playbackRate() * 2);
+        event->accept();
+        break;
     default:
         QMainWindow::keyPressEvent(event);
     }
@@ -79,9 +161,35 @@ void MainWindow::keyPressEvent(QKeyEvent *event)
 
 void MainWindow::updateStatusBar(bool playing)
 {
+    videoplay = playing;
     statusBar()->showMessage(playing ? "Playing" : "Stopped");
 }
 
+void MainWindow::showPlaybackRate(double rate, bool reverse)
+{
+    rateLabel->setText(QString("%1x%2").arg(rate).arg(reverse ? " reverse" : ""));
+}
+
+void MainWindow::showAnnotationOrder()
+{
+    annotationOrderLabel->setVisible(!videoWidget->annotations().isOrdered());
+}
+
+void MainWindow::showMemoryUsage()
+{
+    const MemoryBudget &budget = MemoryBudget::instance();
+    const qint64 mb = 1024 * 1024;
+    memoryLabel->setText(QString("Memory: %1 / %2 MB").arg(budget.used() / mb).arg(budget.budget() / mb));
+
+    QStringList lines;
+    for (int category = 0; category < MemoryBudget::CategoryCount; ++category) {
+        MemoryBudget::Category c = static_cast<MemoryBudget::Category>(category);
+        lines << QString("%1: %2 MB").arg(MemoryBudget::categoryName(c))
+                                     .arg(budget.used(c) / double(mb), 0, 'f', 1);
+    }
+    memoryLabel->setToolTip(lines.join('\n'));
+}
+
 void MainWindow::showFrameInfo(int frameNumber, QSize size)
 {
     statusBar()->showMessage(
@@ -105,6 +213,25 @@ void MainWindow::saveFrame()
     videoWidget->saveCurrentFrame();
 }
 
+void MainWindow::exportAnnotations()
+{
+    const AnnotationParser &annotations = videoWidget->annotations();
+    if (annotations.isEmpty()) {
+        statusBar()->showMessage("No annotations to export!");
+        return;
+    }
+    QFileInfo fi(annotations.fileName());
+    QString fileName = QFileDialog::getSaveFileName(this, "Export Annotations",
+                                                    fi.path() + "/" + fi.completeBaseName() + ".qann",
+                                                    "Binary Annotations (*.qann)");
+    if (fileName.isEmpty())
+        return;
+    if (annotations.saveBinary(fileName))
+        statusBar()->showMessage(QFileInfo(fileName).fileName() + " Saved");
+    else
+        statusBar()->showMessage("Failed to export annotations!");
+}
+
 /*void MainWindow::showCompareDialog()
 {
     if (!compareWidget) {
@@ -126,6 +253,34 @@ void MainWindow::showCompareWindow()
     compareWin->show();
 }
 
+void MainWindow::showStatsWindow()
+{
+    StatsWidget *statsWin = new StatsWidget(videoWidget, nullptr);
+    statsWin->setAttribute(Qt::WA_DeleteOnClose);
+    statsWin->show();
+}
+
+void MainWindow::showTracksWindow()
+{
+    TrackWidget *tracksWin = new TrackWidget(videoWidget, nullptr);
+    tracksWin->setAttribute(Qt::WA_DeleteOnClose);
+    tracksWin->show();
+}
+
+void MainWindow::showGridWindow()
+{
+    QStringList fileNames = QFileDialog::getOpenFileNames(this, "Open MP4 Files", QString(), "Video Files (*.mp4)");
+    if (fileNames.isEmpty())
+        return;
+
+    // Synchronized grid as a top-level window, like the compare window
+    SyncGridWidget *gridWin = new SyncGridWidget(nullptr);
+    gridWin->setAttribute(Qt::WA_DeleteOnClose);
+    gridWin->setVideos(fileNames);
+    gridWin->resize(1280, 800);
+    gridWin->show();
+}
+
 void VideoWidget::pause()
 {
     if (!playing)
@@ -137,57 +292,78 @@ void VideoWidget::pause()
 }
 void VideoWidget::play()
 {
-    if (!cap.isOpened() || playing)
+    if (!decoder || !decoder->isOpened() || playing)
         return;
 
+    // Track played to its end: start it over
+    if (!playlist.isEmpty() && playlistPos + 1 >= playlist.size())
+        showPlaylistPos(0);
+
     playing = true;
-    timer->start(1000 / fps);
+    restartTimer();
     emit playStateChanged(true);
 }
 
+bool VideoWidget::isPlaying() const
+{
+    return playing;
+}
+
 void VideoWidget::showFrame(const cv::Mat& frame, int frameIdx)
 {
-    cv::Mat displayFrame = frame.clone();
-    QSize frameSize = QSize(frame.cols, frame.rows);
-
-    // Draw annotation overlays (if any)
-    const FrameAnnotations* ann = annotationParser.getAnnotations(frameIdx);
-    if (ann) {
-        frameSize = ann->size; // Use annotation size for display
-        for (const FrameLabel& fl : ann->labels) {
-            int x_min = static_cast<int>(fl.xmin * frame.cols);
-            int y_min = static_cast<int>(fl.ymin * frame.rows);
-            int x_max = static_cast<int>(fl.xmax * frame.cols);
-            int y_max = static_cast<int>(fl.ymax * frame.rows);
-            // Draw rectangle
-            cv::rectangle(displayFrame, cv::Point(x_min, y_min), cv::Point(x_max, y_max), cv::Scalar(255,255,255), 2);
-            // Draw label + confidence above box
-            std::stringstream stream;
-            stream << std::fixed << std::setprecision(2) << fl.confidence;
-            std::string conf = stream.str();
-            std::string labelText = fl.label.toStdString() + " " + conf;//.arg(fl.confidence);
-            int baseLine = 0;
-            cv::Size textSize = cv::getTextSize(labelText, cv::FONT_HERSHEY_SIMPLEX, 1, 1, &baseLine);
-            int textY = std::max(y_min - 10, textSize.height + 2);
-            cv::putText(displayFrame, labelText, cv::Point(x_min, textY),
-                        cv::FONT_HERSHEY_SIMPLEX, 1, cv::Scalar(255,255,255), 2);
-        }
-        annotationFrameSize = ann->size;
-    } else {
+    // Held with the base pixmap, so overlay redraws need no lookup
+    baseAnnotations = annotationParser.getAnnotations(frameIdx);
+    if (baseAnnotations)
+        annotationFrameSize = baseAnnotations->size; // Use annotation size for display
+    else if (decoder && decoder->isOpened())
+        annotationFrameSize = decoder->frameSize();    // Native, the frame may be decoded smaller
+    else
         annotationFrameSize = QSize(frame.cols, frame.rows);
+
+    // Scale to annotation size, shrunk to fit the view
+    QSize bound = annotationFrameSize;
+    if (!label->size().isEmpty() && (bound.width() > label->width() || bound.height() > label->height()))
+        bound = bound.scaled(label->size(), Qt::KeepAspectRatio);
+    QSize displaySize = QSize(frame.cols, frame.rows).scaled(bound, Qt::KeepAspectRatio);
+    QPixmap pixmap;
+    QRectF frameRect;   // Where the whole frame lands on the pixmap
+    if (zoom > 1.0) {
+        // Zoomed in: only the visible tiles, at native resolution
+        pixmap = renderZoomed(frame, frameIdx, displaySize, frameRect);
+    } else {
+        // Decoder already delivers RGB at the view size, wrap it; only scale what it did not fit
+        QImage img(frame.data, frame.cols, frame.rows, frame.step, QImage::Format_RGB888);
+        pixmap = QPixmap::fromImage(img);
+        if (pixmap.size() != displaySize)
+            pixmap = pixmap.scaled(displaySize, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+        frameRect = QRectF(pixmap.rect());
     }
 
-    // Convert to QImage and display at annotation size!
-    cv::Mat rgb;
-    cv::cvtColor(displayFrame, rgb, cv::COLOR_BGR2RGB);
+    // Kept without overlay, so filter changes only draw the overlay again
+    basePixmap = pixmap;
+    baseFrameRect = frameRect;
+    baseFrameIdx = frameIdx;
+    displayedSize = pixmap.size();
+    composeOverlay();
+    reportMemory();
 
-    QImage img(rgb.data, rgb.cols, rgb.rows, rgb.step, QImage::Format_RGB888);
+    emit frameInfoChanged(frameIdx, annotationFrameSize);
+}
 
-    // Scale to annotation size, not widget size
-    QPixmap pixmap = QPixmap::fromImage(img).scaled(annotationFrameSize,
-        Qt::KeepAspectRatio, Qt::SmoothTransformation);
+void VideoWidget::composeOverlay()
+{
+    if (basePixmap.isNull())
+        return;
 
+    // Draw annotation overlays (if any) at display resolution, on a copy of the base
+    QPixmap pixmap = basePixmap;
+    {
+        QPainter painter(&pixmap);
+        if (baseAnnotations)
+            drawAnnotationOverlay(painter, *baseAnnotations, baseFrameRect, overlayFilter);
+        int trackRow = tracks.rowOf(playlistTrackId);
+        if (trackRow >= 0)
+            drawTrackTrail(painter, tracks.track(trackRow), baseFrameIdx, baseFrameRect);
+    }
     label->setPixmap(pixmap);
-
-    emit frameInfoChanged(frameIdx, annotationFrameSize);
 }
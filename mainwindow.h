@@ -6,6 +6,7 @@
 
 class VideoWidget;
 class CompareWidget;
+class QLabel;
 
 class MainWindow : public QMainWindow
 {
@@ -22,14 +23,24 @@ private:
     VideoWidget* videoWidget;
     bool videoplay = false;
     CompareWidget *compareWidget = nullptr;
+    QLabel *rateLabel;
+    QLabel *memoryLabel;
+    QLabel *annotationOrderLabel;
 
 private slots:
     void updateStatusBar(bool playing);
     void showFrameInfo(int frameNumber, QSize size);
+    void showPlaybackRate(double rate, bool reverse);
     void showFrameSaved(const QString &filename);
+    void showMemoryUsage();
+    void showAnnotationOrder();
     void saveFrame();
+    void exportAnnotations();
     //void showCompareDialog();
     void showCompareWindow();
+    void showGridWindow();
+    void showStatsWindow();
+    void showTracksWindow();
 };
 
 #endif // MAINWINDOW_H
@@ -0,0 +1,147 @@
+#include "memorybudget.h"
+#include <QCoreApplication>
+#include <QThread>
+#include <QVector>
+#include <algorithm>
+
+namespace {
+
+const qint64 megabyte = 1024 * 1024;
+const qint64 defaultBudget = 2048 * megabyte;
+
+} // namespace
+
+MemoryBudget &MemoryBudget::instance()
+{
+    static MemoryBudget budget;
+    return budget;
+}
+
+QString MemoryBudget::categoryName(Category category)
+{
+    switch (category) {
+    case Tiles:          return "Zoom tiles";
+    case DecodedFrames:  return "Decoded frames";
+    case Thumbnails:     return "Thumbnails";
+    case Annotations:    return "Annotations";
+    case CompareResults: return "Compare results";
+    default:             return QString();
+    }
+}
+
+MemoryBudget::MemoryBudget(QObject *parent)
+    : QObject(parent),
+      budgetBytes(defaultBudget),
+      usedBytes(0),
+      nextHandle(1),
+      enforcePending(false)
+{
+    // QTOPENCV_MEMORY_BUDGET=<MB>, --memory-budget on the command line overrides it
+    bool ok = false;
+    qint64 envMb = qgetenv("QTOPENCV_MEMORY_BUDGET").toLongLong(&ok);
+    if (ok && envMb > 0)
+        budgetBytes = envMb * megabyte;
+
+    // Queued enforce() calls must land on the GUI thread
+    if (QCoreApplication::instance() && thread() != QCoreApplication::instance()->thread())
+        moveToThread(QCoreApplication::instance()->thread());
+}
+
+void MemoryBudget::setBudget(qint64 bytes)
+{
+    {
+        QMutexLocker locker(&mutex);
+        budgetBytes = std::max<qint64>(bytes, 64 * megabyte);
+    }
+    QMetaObject::invokeMethod(this, "enforce", Qt::QueuedConnection);
+}
+
+qint64 MemoryBudget::budget() const
+{
+    QMutexLocker locker(&mutex);
+    return budgetBytes;
+}
+
+qint64 MemoryBudget::used() const
+{
+    QMutexLocker locker(&mutex);
+    return usedBytes;
+}
+
+qint64 MemoryBudget::used(Category category) const
+{
+    QMutexLocker locker(&mutex);
+    qint64 bytes = 0;
+    for (const Consumer &consumer : consumers) {
+        if (consumer.category == category)
+            bytes += consumer.bytes;
+    }
+    return bytes;
+}
+
+qint64 MemoryBudget::available() const
+{
+    QMutexLocker locker(&mutex);
+    return std::max<qint64>(0, budgetBytes - usedBytes);
+}
+
+int MemoryBudget::addConsumer(Category category, const EvictFn &evict)
+{
+    QMutexLocker locker(&mutex);
+    Consumer consumer;
+    consumer.category = category;
+    consumer.bytes = 0;
+    consumer.evict = evict;
+    consumers.insert(nextHandle, consumer);
+    return nextHandle++;
+}
+
+void MemoryBudget::removeConsumer(int handle)
+{
+    QMutexLocker locker(&mutex);
+    auto it = consumers.find(handle);
+    if (it == consumers.end())
+        return;
+    usedBytes -= it->bytes;
+    consumers.erase(it);
+}
+
+void MemoryBudget::setUsage(int handle, qint64 bytes)
+{
+    QMutexLocker locker(&mutex);
+    auto it = consumers.find(handle);
+    if (it == consumers.end())
+        return;
+    usedBytes += bytes - it->bytes;
+    it->bytes = bytes;
+    if (usedBytes > budgetBytes && !enforcePending) {
+        enforcePending = true;
+        QMetaObject::invokeMethod(this, "enforce", Qt::QueuedConnection);
+    }
+}
+
+void MemoryBudget::enforce()
+{
+    // Evict callbacks report back through setUsage(), so they run unlocked
+    QVector<EvictFn> evictors;
+    qint64 over = 0;
+    {
+        QMutexLocker locker(&mutex);
+        enforcePending = false;
+        over = usedBytes - budgetBytes;
+        if (over <= 0)
+            return;
+        for (int category = 0; category < CategoryCount; ++category) {
+            for (const Consumer &consumer : consumers) {
+                if (consumer.category == category && consumer.evict)
+                    evictors << consumer.evict;
+            }
+        }
+    }
+
+    for (const EvictFn &evict : evictors) {
+        if (over <= 0)
+            break;
+        over -= evict(over);
+    }
+}
@@ -0,0 +1,60 @@
+#ifndef MEMORYBUDGET_H
+#define MEMORYBUDGET_H
+
+#include <QObject>
+#include <QMutex>
+#include <QMap>
+#include <QString>
+#include <functional>
+
+// Process wide memory budget. Every large store registers as a consumer
+// and reports its current size; when the total goes over the budget the
+// evictable consumers are asked to free memory, cheapest to rebuild first.
+// setUsage() may be called from any thread, eviction runs on the GUI thread.
+class MemoryBudget : public QObject
+{
+    Q_OBJECT
+
+public:
+    // Also the eviction order
+    enum Category { Tiles, DecodedFrames, Thumbnails, Annotations, CompareResults, CategoryCount };
+
+    // Asked to free about this many bytes, returns what it freed
+    typedef std::function<qint64(qint64)> EvictFn;
+
+    static MemoryBudget &instance();
+    static QString categoryName(Category category);
+
+    void setBudget(qint64 bytes);
+    qint64 budget() const;
+    qint64 used() const;
+    qint64 used(Category category) const;
+    // Room left before eviction starts, 0 when over
+    qint64 available() const;
+
+    // Returns a handle for setUsage()/removeConsumer(); evict may be empty
+    int addConsumer(Category category, const EvictFn &evict = EvictFn());
+    void removeConsumer(int handle);
+    void setUsage(int handle, qint64 bytes);
+
+public slots:
+    void enforce();
+
+private:
+    explicit MemoryBudget(QObject *parent = nullptr);
+
+    struct Consumer {
+        Category category;
+        qint64 bytes;
+        EvictFn evict;
+    };
+
+    mutable QMutex mutex;
+    QMap<int, Consumer> consumers;
+    qint64 budgetBytes;
+    qint64 usedBytes;
+    int nextHandle;
+    bool enforcePending;
+};
+
+#endif // MEMORYBUDGET_H
@@ -0,0 +1,89 @@
+#include "overlayfilterwidget.h"
+#include "videowidget.h"
+#include <QSlider>
+#include <QLabel>
+#include <QListWidget>
+#include <QPushButton>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+
+OverlayFilterWidget::OverlayFilterWidget(VideoWidget *videoWidget, QWidget *parent)
+    : QWidget(parent),
+      videoWidget(videoWidget)
+{
+    confidenceSlider = new QSlider(Qt::Horizontal, this);
+    confidenceSlider->setRange(0, 100);     // Hundredths
+    confidenceLabel = new QLabel(this);
+    labelList = new QListWidget(this);
+    allButton = new QPushButton("All", this);
+    noneButton = new QPushButton("None", this);
+
+    QHBoxLayout *confidenceLayout = new QHBoxLayout;
+    confidenceLayout->addWidget(new QLabel("Min confidence:", this));
+    confidenceLayout->addWidget(confidenceSlider);
+    confidenceLayout->addWidget(confidenceLabel);
+
+    QHBoxLayout *buttonLayout = new QHBoxLayout;
+    buttonLayout->addWidget(allButton);
+    buttonLayout->addWidget(noneButton);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    mainLayout->addLayout(confidenceLayout);
+    mainLayout->addWidget(new QLabel("Labels:", this));
+    mainLayout->addWidget(labelList);
+    mainLayout->addLayout(buttonLayout);
+    setLayout(mainLayout);
+
+    connect(confidenceSlider, &QSlider::valueChanged, this, &OverlayFilterWidget::applyFilter);
+    connect(labelList, &QListWidget::itemChanged, this, &OverlayFilterWidget::applyFilter);
+    connect(allButton, &QPushButton::clicked, this, [this]() { setAllLabels(true); });
+    connect(noneButton, &QPushButton::clicked, this, [this]() { setAllLabels(false); });
+    connect(videoWidget, &VideoWidget::annotationsChanged, this, &OverlayFilterWidget::reloadLabels);
+
+    reloadLabels();
+    applyFilter();
+}
+
+void OverlayFilterWidget::reloadLabels()
+{
+    if (!videoWidget)
+        return;
+    // Labels hidden before stay hidden, new ones are shown
+    const OverlayFilter &filter = videoWidget->currentOverlayFilter();
+    labelList->blockSignals(true);
+    labelList->clear();
+    QStringList labels = videoWidget->annotationStatistics().labels();
+    labels.sort();
+    for (const QString &name : labels) {
+        QListWidgetItem *item = new QListWidgetItem(name, labelList);
+        item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
+        item->setCheckState(filter.hiddenLabels.contains(name) ? Qt::Unchecked : Qt::Checked);
+    }
+    labelList->blockSignals(false);
+}
+
+void OverlayFilterWidget::applyFilter()
+{
+    confidenceLabel->setText(QString::number(confidenceSlider->value() / 100.0, 'f', 2));
+    if (!videoWidget)
+        return;
+
+    OverlayFilter filter = videoWidget->currentOverlayFilter();
+    filter.minConfidence = confidenceSlider->value() / 100.0f;
+    filter.hiddenLabels.clear();
+    for (int i = 0; i < labelList->count(); ++i) {
+        QListWidgetItem *item = labelList->item(i);
+        if (item->checkState() != Qt::Checked)
+            filter.hiddenLabels.insert(item->text());
+    }
+    videoWidget->setOverlayFilter(filter);
+}
+
+void OverlayFilterWidget::setAllLabels(bool shown)
+{
+    labelList->blockSignals(true);
+    for (int i = 0; i < labelList->count(); ++i)
+        labelList->item(i)->setCheckState(shown ? Qt::Checked : Qt::Unchecked);
+    labelList->blockSignals(false);
+    applyFilter();
+}
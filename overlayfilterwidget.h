@@ -0,0 +1,36 @@
+#ifndef OVERLAYFILTERWIDGET_H
+#define OVERLAYFILTERWIDGET_H
+
+#include <QWidget>
+#include <QPointer>
+
+class VideoWidget;
+class QSlider;
+class QLabel;
+class QListWidget;
+class QListWidgetItem;
+class QPushButton;
+
+// Confidence threshold and label checkboxes for the overlay of a VideoWidget
+class OverlayFilterWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit OverlayFilterWidget(VideoWidget *videoWidget, QWidget *parent = nullptr);
+
+private slots:
+    void reloadLabels();
+    void applyFilter();
+    void setAllLabels(bool shown);
+
+private:
+    QPointer<VideoWidget> videoWidget;
+    QSlider *confidenceSlider;
+    QLabel *confidenceLabel;
+    QListWidget *labelList;
+    QPushButton *allButton;
+    QPushButton *noneButton;
+};
+
+#endif // OVERLAYFILTERWIDGET_H
@@ -0,0 +1,225 @@
+#include "statswidget.h"
+#include "videowidget.h"
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+#include <QSpinBox>
+#include <QPushButton>
+#include <QLabel>
+#include <QTabWidget>
+#include <QTableWidget>
+#include <QHeaderView>
+#include <QElapsedTimer>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+const int barWidth = 40;
+
+QTableWidget *makeTable(const QStringList &headers, QWidget *parent)
+{
+    QTableWidget *table = new QTableWidget(parent);
+    table->setColumnCount(headers.size());
+    table->setHorizontalHeaderLabels(headers);
+    table->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->verticalHeader()->setVisible(false);
+    return table;
+}
+
+// Numeric display role, so sorting the column sorts by value
+QTableWidgetItem *numberItem(double value, int decimals = 0)
+{
+    double scale = std::pow(10.0, decimals);
+    QTableWidgetItem *item = new QTableWidgetItem;
+    item->setData(Qt::DisplayRole, std::round(value * scale) / scale);
+    return item;
+}
+
+QStringList rangeNames(int bins, double binWidth)
+{
+    QStringList names;
+    for (int i = 0; i < bins; ++i)
+        names << QString("%1 - %2").arg(i * binWidth, 0, 'f', 2).arg((i + 1) * binWidth, 0, 'f', 2);
+    return names;
+}
+
+} // namespace
+
+StatsWidget::StatsWidget(VideoWidget *videoWidget, QWidget *parent)
+    : QWidget(parent),
+      videoWidget(videoWidget)
+{
+    fromSpin = new QSpinBox(this);
+    toSpin = new QSpinBox(this);
+    applyButton = new QPushButton("Apply", this);
+    reloadButton = new QPushButton("Reload appended", this);
+    summaryLabel = new QLabel(this);
+    tabs = new QTabWidget(this);
+
+    labelTable = makeTable({"Label", "Boxes", "Share %", "Mean confidence"}, this);
+    labelTable->setSortingEnabled(true);
+    confidenceTable = makeTable({"Confidence", "Boxes", ""}, this);
+    sizeTable = makeTable({"Box size (sqrt of area)", "Boxes", ""}, this);
+    boxesTable = makeTable({"Boxes in frame", "Frames", ""}, this);
+
+    QWidget *trackPage = new QWidget(this);
+    trackLabel = new QLabel(trackPage);
+    trackTable = makeTable({"Lifetime (frames)", "Tracks", ""}, trackPage);
+    QVBoxLayout *trackLayout = new QVBoxLayout(trackPage);
+    trackLayout->addWidget(trackLabel);
+    trackLayout->addWidget(trackTable);
+
+    tabs->addTab(labelTable, "Labels");
+    tabs->addTab(confidenceTable, "Confidence");
+    tabs->addTab(sizeTable, "Box size");
+    tabs->addTab(boxesTable, "Boxes per frame");
+    tabs->addTab(trackPage, "Tracks");
+
+    QHBoxLayout *rangeLayout = new QHBoxLayout;
+    rangeLayout->addWidget(new QLabel("Frames from:", this));
+    rangeLayout->addWidget(fromSpin);
+    rangeLayout->addWidget(new QLabel("to:", this));
+    rangeLayout->addWidget(toSpin);
+    rangeLayout->addWidget(applyButton);
+    rangeLayout->addStretch();
+    rangeLayout->addWidget(reloadButton);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    mainLayout->addLayout(rangeLayout);
+    mainLayout->addWidget(summaryLabel);
+    mainLayout->addWidget(tabs);
+    setLayout(mainLayout);
+
+    fromSpin->setRange(0, 0);
+    toSpin->setRange(0, 0);
+
+    connect(applyButton, &QPushButton::clicked, this, &StatsWidget::applyRange);
+    connect(reloadButton, &QPushButton::clicked, this, &StatsWidget::reloadAppended);
+    connect(videoWidget, &VideoWidget::annotationsChanged, this, &StatsWidget::refresh);
+
+    setWindowTitle("Annotation Statistics");
+    resize(900, 600);
+    refresh();
+}
+
+void StatsWidget::refresh()
+{
+    if (!videoWidget)
+        return;
+    const AnnotationStats &stats = videoWidget->annotationStatistics();
+
+    // Keep the range the user picked, but follow the end while frames are appended
+    bool atEnd = toSpin->value() >= toSpin->maximum();
+    int first = std::max(0, stats.firstFrame());
+    int last = std::max(0, stats.lastFrame());
+    fromSpin->setRange(first, last);
+    toSpin->setRange(first, last);
+    if (atEnd)
+        toSpin->setValue(last);
+
+    applyRange();
+    showTracks();
+}
+
+void StatsWidget::applyRange()
+{
+    if (!videoWidget)
+        return;
+
+    QElapsedTimer timer;
+    timer.start();
+    AnnotationStats::Summary summary = videoWidget->annotationStatistics().range(
+        videoWidget->annotations(), fromSpin->value(), toSpin->value());
+    qint64 elapsed = timer.nsecsElapsed() / 1000;
+
+    showSummary(summary);
+    summaryLabel->setText(QString("Frames %1 - %2: %3 annotated frames, %4 boxes (%5 per frame). Query took %6 us.")
+                              .arg(fromSpin->value())
+                              .arg(toSpin->value())
+                              .arg(summary.frames)
+                              .arg(summary.boxes)
+                              .arg(summary.frames > 0 ? double(summary.boxes) / summary.frames : 0.0, 0, 'f', 2)
+                              .arg(elapsed));
+}
+
+void StatsWidget::reloadAppended()
+{
+    if (videoWidget)
+        videoWidget->reloadAnnotations();
+}
+
+void StatsWidget::showSummary(const AnnotationStats::Summary &summary)
+{
+    const QStringList &labels = videoWidget->annotationStatistics().labels();
+
+    labelTable->setSortingEnabled(false);
+    labelTable->setRowCount(0);
+    int row = 0;
+    for (int i = 0; i < summary.labelCounts.size() && i < labels.size(); ++i) {
+        qint64 count = summary.labelCounts[i];
+        if (count == 0)
+            continue;
+        labelTable->insertRow(row);
+        labelTable->setItem(row, 0, new QTableWidgetItem(labels[i]));
+        labelTable->setItem(row, 1, numberItem(count));
+        labelTable->setItem(row, 2, numberItem(summary.boxes > 0 ? 100.0 * count / summary.boxes : 0.0, 1));
+        labelTable->setItem(row, 3, numberItem(summary.labelConfidenceSum[i] / count, 3));
+        ++row;
+    }
+    labelTable->setSortingEnabled(true);
+    labelTable->sortItems(1, Qt::DescendingOrder);
+
+    fillHistogram(confidenceTable, rangeNames(AnnotationStats::confidenceBins, 1.0 / AnnotationStats::confidenceBins),
+                  summary.confidenceHistogram);
+    fillHistogram(sizeTable, rangeNames(AnnotationStats::sizeBins, 1.0 / AnnotationStats::sizeBins),
+                  summary.sizeHistogram);
+
+    QStringList boxNames;
+    for (int i = 0; i < AnnotationStats::maxBoxesPerFrame; ++i)
+        boxNames << QString::number(i);
+    boxNames << QString("%1 or more").arg(AnnotationStats::maxBoxesPerFrame);
+    fillHistogram(boxesTable, boxNames, summary.boxesPerFrameHistogram);
+}
+
+void StatsWidget::showTracks()
+{
+    // Same tracks as the track table
+    const TrackIndex &index = videoWidget->trackIndex();
+    qint64 totalLifetime = 0;
+    int longest = 0;
+    for (int row = 0; row < index.size(); ++row) {
+        int lifetime = index.track(row).lifetime();
+        totalLifetime += lifetime;
+        longest = std::max(longest, lifetime);
+    }
+    int tracks = index.size();
+    trackLabel->setText(QString("%1 tracks, mean lifetime %2 frames, longest %3 frames (whole run).")
+                            .arg(tracks)
+                            .arg(tracks > 0 ? double(totalLifetime) / tracks : 0.0, 0, 'f', 1)
+                            .arg(longest));
+
+    QStringList names;
+    for (int i = 0; i < TrackIndex::lifetimeBins; ++i) {
+        if (i == TrackIndex::lifetimeBins - 1)
+            names << QString("%1 or more").arg(1 << i);
+        else
+            names << QString("%1 - %2").arg(1 << i).arg((1 << (i + 1)) - 1);
+    }
+    fillHistogram(trackTable, names, index.lifetimeHistogram());
+}
+
+void StatsWidget::fillHistogram(QTableWidget *table, const QStringList &binNames, const QVector<qint64> &counts)
+{
+    qint64 maxCount = 1;
+    for (qint64 count : counts)
+        maxCount = std::max(maxCount, count);
+
+    table->setRowCount(counts.size());
+    for (int i = 0; i < counts.size(); ++i) {
+        int bar = static_cast<int>(barWidth * counts[i] / maxCount);
+        table->setItem(i, 0, new QTableWidgetItem(i < binNames.size() ? binNames[i] : QString::number(i)));
+        table->setItem(i, 1, numberItem(counts[i]));
+        table->setItem(i, 2, new QTableWidgetItem(QString(bar, QChar(0x2588))));
+    }
+}
@@ -0,0 +1,52 @@
+#ifndef STATSWIDGET_H
+#define STATSWIDGET_H
+
+#include <QWidget>
+#include <QPointer>
+#include <QStringList>
+#include <QVector>
+#include "annotationstats.h"
+
+class VideoWidget;
+class QSpinBox;
+class QPushButton;
+class QLabel;
+class QTabWidget;
+class QTableWidget;
+
+// Overview of the annotation run of the video shown in a VideoWidget:
+// per label counts, confidence, box size and boxes per frame histograms
+// for a frame range, and track lifetimes from the tracker ID.
+class StatsWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit StatsWidget(VideoWidget *videoWidget, QWidget *parent = nullptr);
+
+private slots:
+    void refresh();
+    void applyRange();
+    void reloadAppended();
+
+private:
+    void showSummary(const AnnotationStats::Summary &summary);
+    void showTracks();
+    void fillHistogram(QTableWidget *table, const QStringList &binNames, const QVector<qint64> &counts);
+
+    QPointer<VideoWidget> videoWidget;
+    QSpinBox *fromSpin;
+    QSpinBox *toSpin;
+    QPushButton *applyButton;
+    QPushButton *reloadButton;
+    QLabel *summaryLabel;
+    QTabWidget *tabs;
+    QTableWidget *labelTable;
+    QTableWidget *confidenceTable;
+    QTableWidget *sizeTable;
+    QTableWidget *boxesTable;
+    QTableWidget *trackTable;
+    QLabel *trackLabel;
+};
+
+#endif // STATSWIDGET_H
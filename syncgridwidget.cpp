@@ -0,0 +1,380 @@
+#include "syncgridwidget.h"
+#include "annotationoverlay.h"
+#include <QLabel>
+#include <QSlider>
+#include <QGridLayout>
+#include <QVBoxLayout>
+#include <QRunnable>
+#include <QThread>
+#include <QPainter>
+#include <QKeyEvent>
+#include <QCloseEvent>
+#include <QResizeEvent>
+#include <QShowEvent>
+#include <QFileInfo>
+#include <QCoreApplication>
+#include <cmath>
+#include <algorithm>
+
+namespace {
+
+class PaneDecodeTask : public QRunnable
+{
+public:
+    PaneDecodeTask(GridPane *pane, int frameIdx, QSize targetSize)
+        : pane(pane), frameIdx(frameIdx), targetSize(targetSize) {}
+
+    void run() override { pane->decode(frameIdx, targetSize); }
+
+private:
+    GridPane *pane;
+    int frameIdx;
+    QSize targetSize;
+};
+
+} // namespace
+
+GridPane::GridPane(int index, QLabel *view, QObject *parent)
+    : QObject(parent),
+      index(index),
+      view(view)
+{
+}
+
+bool GridPane::open(const QString &filePath, int threadCount)
+{
+    this->filePath = filePath;
+    // RGB scaled to the pane size straight out of the decoder
+    decoder = DecodeBackend::openFile(filePath, DecodeBackend::RGB, threadCount);
+
+    // Same convention as VideoWidget: annotations next to the video
+    annotationParser.loadFromFile(AnnotationParser::annotationFileFor(filePath));
+
+    if (!decoder->isOpened())
+        return false;
+    fps = decoder->fps();
+    totalFrames = decoder->frameCount();
+    return true;
+}
+
+void GridPane::decode(int frameIdx, QSize targetSize)
+{
+    QImage image;
+    cv::Mat frame;
+
+    if (decoder && decoder->isOpened()) {
+        decoder->setOutputSize(targetSize);
+        decoder->readFrame(frameIdx, frame);
+    }
+
+    if (!frame.empty()) {
+        image = QImage(frame.data, frame.cols, frame.rows, frame.step, QImage::Format_RGB888).copy();
+
+        std::shared_ptr<const FrameAnnotations> ann = annotationParser.getAnnotations(frameIdx);
+        if (ann) {
+            QPainter painter(&image);
+            drawAnnotationOverlay(painter, *ann, QRectF(image.rect()));
+        }
+    }
+
+    emit frameDecoded(index, frameIdx, image);
+}
+
+SyncGridWidget::SyncGridWidget(QWidget *parent)
+    : QWidget(parent),
+      grid(new QGridLayout),
+      clock(new QTimer(this)),
+      refreshTimer(new QTimer(this)),
+      frameSlider(new QSlider(Qt::Horizontal, this)),
+      statusLabel(new QLabel(this)),
+      fps(30.0),
+      totalFrames(0),
+      playing(false),
+      clockStartFrame(0),
+      currentFrameIdx(-1),
+      requestedFrameIdx(-1),
+      deferredFrameIdx(-1),
+      pendingDecodes(0),
+      droppedFrames(0)
+{
+    // One pool shared by all panes, one thread per core
+    decodePool.setMaxThreadCount(QThread::idealThreadCount());
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->addLayout(grid, 1);
+    layout->addWidget(frameSlider);
+    layout->addWidget(statusLabel);
+    setLayout(layout);
+
+    clock->setTimerType(Qt::PreciseTimer);
+    connect(clock, &QTimer::timeout, this, &SyncGridWidget::clockTick);
+
+    refreshTimer->setSingleShot(true);
+    refreshTimer->setInterval(0);
+    connect(refreshTimer, &QTimer::timeout, this, &SyncGridWidget::refreshFrame);
+
+    frameSlider->setMinimum(0);
+    frameSlider->setMaximum(0);
+    frameSlider->setEnabled(false);
+    connect(frameSlider, &QSlider::valueChanged, this, &SyncGridWidget::seek);
+
+    setFocusPolicy(Qt::StrongFocus);
+    setWindowTitle("Synchronized Grid");
+}
+
+SyncGridWidget::~SyncGridWidget()
+{
+    clock->stop();
+    decodePool.waitForDone();
+}
+
+void SyncGridWidget::clearPanes()
+{
+    pause();
+    decodePool.waitForDone();
+    // Drop frameDecoded calls still queued from the old panes
+    QCoreApplication::removePostedEvents(this, QEvent::MetaCall);
+    for (GridPane *pane : panes) {
+        delete pane->view;
+        delete pane;
+    }
+    panes.clear();
+    pendingImages.clear();
+    pendingDecodes = 0;
+    deferredFrameIdx = -1;
+    requestedFrameIdx = -1;
+    currentFrameIdx = -1;
+    droppedFrames = 0;
+}
+
+void SyncGridWidget::setVideos(const QStringList &filePaths)
+{
+    clearPanes();
+
+    int columns = static_cast<int>(std::ceil(std::sqrt(static_cast<double>(filePaths.size()))));
+    totalFrames = 0;
+    fps = 0.0;
+    QStringList names;
+    // The pool already runs the panes in parallel, split the cores between their decoders
+    int decodeThreads = std::max(1, QThread::idealThreadCount() / std::max(1, filePaths.size()));
+    for (int i = 0; i < filePaths.size(); ++i) {
+        QLabel *view = new QLabel(this);
+        view->setAlignment(Qt::AlignCenter);
+        view->setMinimumSize(160, 90);
+        view->setSizePolicy(QSizePolicy::Ignored, QSizePolicy::Ignored);
+        grid->addWidget(view, i / columns, i % columns);
+
+        GridPane *pane = new GridPane(i, view, this);
+        connect(pane, &GridPane::frameDecoded, this, &SyncGridWidget::onFrameDecoded);
+        if (!pane->open(filePaths[i], decodeThreads))
+            view->setText("Failed to open video.");
+        panes.push_back(pane);
+        names << QFileInfo(filePaths[i]).fileName();
+
+        // Master clock runs at the first video's rate, the grid ends with the shortest one
+        if (fps <= 0.0 && pane->fps > 0.0)
+            fps = pane->fps;
+        if (pane->totalFrames > 0 && (totalFrames == 0 || pane->totalFrames < totalFrames))
+            totalFrames = pane->totalFrames;
+    }
+    if (fps <= 0.0)
+        fps = 30.0;
+    pendingImages.resize(panes.size());
+    setWindowTitle("Synchronized Grid - " + names.join(", "));
+
+    frameSlider->blockSignals(true);
+    frameSlider->setMaximum(totalFrames > 0 ? totalFrames - 1 : 0);
+    frameSlider->setValue(0);
+    frameSlider->blockSignals(false);
+    frameSlider->setEnabled(totalFrames > 0);
+
+    if (totalFrames > 0)
+        requestFrame(0);
+}
+
+void SyncGridWidget::play()
+{
+    if (playing || panes.isEmpty() || totalFrames <= 0)
+        return;
+
+    playing = true;
+    clockStartFrame = currentFrameIdx < 0 ? 0 : currentFrameIdx;
+    clockElapsed.start();
+    clock->start(qMax(1, static_cast<int>(1000.0 / fps)));
+    emit playStateChanged(true);
+    updateStatus();
+}
+
+void SyncGridWidget::pause()
+{
+    if (!playing)
+        return;
+
+    playing = false;
+    clock->stop();
+    emit playStateChanged(false);
+    updateStatus();
+}
+
+bool SyncGridWidget::isPlaying() const
+{
+    return playing;
+}
+
+void SyncGridWidget::nextFrame()
+{
+    if (playing) pause();
+    seek(qMin(currentFrameIdx + 1, totalFrames - 1));
+}
+
+void SyncGridWidget::prevFrame()
+{
+    if (playing) pause();
+    seek(qMax(currentFrameIdx - 1, 0));
+}
+
+void SyncGridWidget::seek(int frameNumber)
+{
+    if (panes.isEmpty() || totalFrames <= 0)
+        return;
+
+    if (playing) pause();
+
+    if (frameNumber == currentFrameIdx && pendingDecodes == 0)
+        return;
+
+    // Panes still busy with the previous frame: take the newest seek when they are done
+    if (pendingDecodes > 0) {
+        deferredFrameIdx = frameNumber;
+        return;
+    }
+    requestFrame(frameNumber);
+}
+
+void SyncGridWidget::clockTick()
+{
+    int target = clockStartFrame + static_cast<int>(clockElapsed.elapsed() * fps / 1000.0);
+    if (target >= totalFrames)
+        target = totalFrames - 1;
+    if (target == currentFrameIdx || target == requestedFrameIdx)
+        return;
+
+    // Some pane has not delivered the last frame yet: every pane skips this tick
+    if (pendingDecodes > 0)
+        return;
+
+    if (currentFrameIdx >= 0 && target > currentFrameIdx + 1)
+        droppedFrames += target - currentFrameIdx - 1;
+    requestFrame(target);
+}
+
+void SyncGridWidget::requestFrame(int frameIdx)
+{
+    requestedFrameIdx = frameIdx;
+    deferredFrameIdx = -1;
+    pendingDecodes = panes.size();
+    for (GridPane *pane : panes) {
+        pendingImages[pane->index] = QImage();
+        decodePool.start(new PaneDecodeTask(pane, frameIdx, pane->view->size()));
+    }
+}
+
+void SyncGridWidget::onFrameDecoded(int paneIndex, int frameIdx, const QImage &image)
+{
+    if (frameIdx != requestedFrameIdx || paneIndex < 0 || paneIndex >= pendingImages.size())
+        return;
+
+    pendingImages[paneIndex] = image;
+    if (--pendingDecodes == 0)
+        presentFrame();
+}
+
+void SyncGridWidget::presentFrame()
+{
+    // All panes have the frame, show them together
+    for (GridPane *pane : panes) {
+        const QImage &image = pendingImages[pane->index];
+        if (image.isNull())
+            pane->view->setText("Failed to read frame.");
+        else
+            pane->view->setPixmap(QPixmap::fromImage(image));
+    }
+    currentFrameIdx = requestedFrameIdx;
+
+    frameSlider->blockSignals(true);
+    frameSlider->setValue(currentFrameIdx);
+    frameSlider->blockSignals(false);
+
+    if (playing && currentFrameIdx >= totalFrames - 1)
+        pause();
+    updateStatus();
+
+    if (deferredFrameIdx >= 0)
+        requestFrame(deferredFrameIdx);
+}
+
+void SyncGridWidget::refreshFrame()
+{
+    // While playing the next tick already decodes at the new size
+    if (playing || panes.isEmpty() || totalFrames <= 0)
+        return;
+    int frameIdx = currentFrameIdx < 0 ? 0 : currentFrameIdx;
+    if (pendingDecodes > 0) {
+        if (deferredFrameIdx < 0)
+            deferredFrameIdx = frameIdx;
+        return;
+    }
+    requestFrame(frameIdx);
+}
+
+void SyncGridWidget::resizeEvent(QResizeEvent *event)
+{
+    QWidget::resizeEvent(event);
+    refreshTimer->start();
+}
+
+void SyncGridWidget::showEvent(QShowEvent *event)
+{
+    QWidget::showEvent(event);
+    refreshTimer->start();
+}
+
+void SyncGridWidget::updateStatus()
+{
+    statusLabel->setText(QString("%1  Frame: %2/%3  Dropped: %4  Decode threads: %5")
+                             .arg(playing ? "Playing" : "Stopped")
+                             .arg(currentFrameIdx, 6, 10, QChar('0'))
+                             .arg(totalFrames)
+                             .arg(droppedFrames)
+                             .arg(decodePool.maxThreadCount()));
+}
+
+void SyncGridWidget::keyPressEvent(QKeyEvent *event)
+{
+    switch (event->key()) {
+    case Qt::Key_Space:
+        if (playing)
+            pause();
+        else
+            play();
+        event->accept();
+        break;
+    case Qt::Key_Left:
+        prevFrame();
+        event->accept();
+        break;
+    case Qt::Key_Right:
+        nextFrame();
+        event->accept();
+        break;
+    default:
+        QWidget::keyPressEvent(event);
+    }
+}
+
+void SyncGridWidget::closeEvent(QCloseEvent *event)
+{
+    clock->stop();
+    decodePool.waitForDone();
+    QWidget::closeEvent(event);
+}
@@ -0,0 +1,109 @@
+#ifndef SYNCGRIDWIDGET_H
+#define SYNCGRIDWIDGET_H
+
+#include <QWidget>
+#include <QObject>
+#include <QTimer>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QVector>
+#include <QImage>
+#include <QStringList>
+#include <memory>
+#include "annotationparser.h"
+#include "decodebackend.h"
+
+class QLabel;
+class QSlider;
+class QGridLayout;
+
+// One video of the grid. The decoder is only touched by the decode task
+// running for this pane, SyncGridWidget never starts two at once.
+class GridPane : public QObject
+{
+    Q_OBJECT
+
+public:
+    GridPane(int index, QLabel *view, QObject *parent = nullptr);
+
+    bool open(const QString &filePath, int threadCount);
+    // Runs on a decode pool thread
+    void decode(int frameIdx, QSize targetSize);
+
+    int index;
+    QLabel *view;
+    QString filePath;
+    double fps = 0.0;
+    int totalFrames = 0;
+
+signals:
+    void frameDecoded(int paneIndex, int frameIdx, const QImage &image);
+
+private:
+    std::unique_ptr<DecodeBackend> decoder;
+    AnnotationParser annotationParser;
+};
+
+// Plays N videos side by side, driven by one master clock. All panes
+// decode on a shared pool and a frame is only shown once every pane has
+// it, so when decoding falls behind the whole grid drops the same frames.
+class SyncGridWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit SyncGridWidget(QWidget *parent = nullptr);
+    ~SyncGridWidget() override;
+
+    void setVideos(const QStringList &filePaths);
+    void play();
+    void pause();
+    bool isPlaying() const;
+
+public slots:
+    void nextFrame();
+    void prevFrame();
+    void seek(int frameNumber);
+
+signals:
+    void playStateChanged(bool playing);
+
+protected:
+    void keyPressEvent(QKeyEvent *event) override;
+    void closeEvent(QCloseEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void showEvent(QShowEvent *event) override;
+
+private slots:
+    void clockTick();
+    // Decodes the shown frame again at the current pane size
+    void refreshFrame();
+    void onFrameDecoded(int paneIndex, int frameIdx, const QImage &image);
+
+private:
+    void clearPanes();
+    void requestFrame(int frameIdx);
+    void presentFrame();
+    void updateStatus();
+
+    QThreadPool decodePool;
+    QVector<GridPane*> panes;
+    QVector<QImage> pendingImages;
+    QGridLayout *grid;
+    QTimer *clock;
+    QTimer *refreshTimer;               // Coalesces resizes to one decode
+    QElapsedTimer clockElapsed;
+    QSlider *frameSlider;
+    QLabel *statusLabel;
+    double fps;
+    int totalFrames;
+    bool playing;
+    int clockStartFrame;
+    int currentFrameIdx;
+    int requestedFrameIdx;
+    int deferredFrameIdx;
+    int pendingDecodes;
+    int droppedFrames;
+};
+
+#endif // SYNCGRIDWIDGET_H
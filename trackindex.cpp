@@ -0,0 +1,234 @@
+#include "trackindex.h"
+#include "memorybudget.h"
+#include <QDataStream>
+#include <algorithm>
+#include <limits>
+
+namespace {
+
+quint16 quantize(float value)
+{
+    return static_cast<quint16>(std::max(0.0f, std::min(value, 1.0f)) * 65535.0f + 0.5f);
+}
+
+} // namespace
+
+const int TrackIndex::lifetimeBins;
+
+QRectF TrackInfo::boxAt(int i) const
+{
+    const quint16 *b = boxes.constData() + 4 * i;
+    return QRectF(QPointF(b[0] / 65535.0, b[1] / 65535.0), QPointF(b[2] / 65535.0, b[3] / 65535.0));
+}
+
+TrackIndex::TrackIndex()
+{
+    // Needed for the track table and trails, so counted but never evicted
+    budgetHandle = MemoryBudget::instance().addConsumer(MemoryBudget::Annotations);
+}
+
+TrackIndex::~TrackIndex()
+{
+    MemoryBudget::instance().removeConsumer(budgetHandle);
+}
+
+QVector<qint64> TrackIndex::lifetimeHistogram() const
+{
+    QVector<qint64> histogram(lifetimeBins);
+    for (const TrackInfo &track : tracks) {
+        int lifetime = track.lifetime();
+        int bin = 0;
+        while ((lifetime >>= 1) > 0 && bin < lifetimeBins - 1)
+            ++bin;
+        histogram[bin] += 1;
+    }
+    return histogram;
+}
+
+void TrackIndex::clear()
+{
+    tracks.clear();
+    rowById.clear();
+    labelNames.clear();
+    labelIds.clear();
+    frameLabels.clear();
+    MemoryBudget::instance().setUsage(budgetHandle, 0);
+}
+
+void TrackIndex::build(const AnnotationParser &parser)
+{
+    clear();
+    QSet<int> changedRows;
+    addFrames(parser, 0, changedRows);
+    for (int row = 0; row < tracks.size(); ++row) {
+        finishTrack(row);
+        tracks[row].frames.squeeze();
+        tracks[row].boxes.squeeze();
+        tracks[row].confidences.squeeze();
+        frameLabels[row].squeeze();
+    }
+    reportUsage();
+}
+
+void TrackIndex::update(const AnnotationParser &parser, int fromFrame)
+{
+    // Frames are ascending per track, so what was read from fromFrame on is a tail
+    QSet<int> changedRows;
+    int kept = 0;
+    for (int row = 0; row < tracks.size(); ++row) {
+        TrackInfo &track = tracks[row];
+        int keep = static_cast<int>(std::lower_bound(track.frames.constBegin(), track.frames.constEnd(), fromFrame)
+                                    - track.frames.constBegin());
+        if (keep == 0)
+            continue;   // Only seen from fromFrame on, comes back if still there
+        if (keep < track.frames.size()) {
+            track.frames.resize(keep);
+            track.boxes.resize(4 * keep);
+            track.confidences.resize(keep);
+            frameLabels[row].resize(keep);
+            track.lastFrame = track.frames.last();
+            changedRows.insert(kept);
+        }
+        if (kept != row) {
+            tracks[kept] = std::move(track);
+            frameLabels[kept] = std::move(frameLabels[row]);
+        }
+        ++kept;
+    }
+    tracks.resize(kept);
+    frameLabels.resize(kept);
+    rowById.clear();
+    for (int row = 0; row < tracks.size(); ++row)
+        rowById.insert(tracks[row].id, row);
+
+    addFrames(parser, fromFrame, changedRows);
+    for (int row : changedRows)
+        finishTrack(row);
+    reportUsage();
+}
+
+void TrackIndex::addFrames(const AnnotationParser &parser, int first, QSet<int> &changedRows)
+{
+    // Frames come in order, so each track's frames come out ascending
+    parser.forEachFrame(first, std::numeric_limits<int>::max(), [&](const FrameAnnotations &frame) {
+        for (const FrameLabel &fl : frame.labels) {
+            if (fl.id <= 0)   // 0 = not tracked
+                continue;
+            int row = rowById.value(fl.id, -1);
+            if (row < 0) {
+                row = tracks.size();
+                rowById.insert(fl.id, row);
+                TrackInfo track;
+                track.id = fl.id;
+                track.firstFrame = frame.frameNumber;
+                tracks.push_back(track);
+                frameLabels.push_back(QVector<int>());
+            }
+
+            TrackInfo &track = tracks[row];
+            // Same ID twice in one frame: keep the first box
+            if (!track.frames.isEmpty() && track.frames.last() == frame.frameNumber)
+                continue;
+            track.frames.push_back(frame.frameNumber);
+            track.boxes << quantize(fl.xmin) << quantize(fl.ymin) << quantize(fl.xmax) << quantize(fl.ymax);
+            track.confidences.push_back(fl.confidence);
+            track.lastFrame = frame.frameNumber;
+            frameLabels[row].push_back(labelId(fl.label));
+            changedRows.insert(row);
+        }
+    });
+}
+
+void TrackIndex::finishTrack(int row)
+{
+    TrackInfo &track = tracks[row];
+    double confidenceSum = 0.0;
+    track.minConfidence = track.confidences.first();
+    track.maxConfidence = track.confidences.first();
+    for (float confidence : track.confidences) {
+        track.minConfidence = std::min(track.minConfidence, confidence);
+        track.maxConfidence = std::max(track.maxConfidence, confidence);
+        confidenceSum += confidence;
+    }
+    track.meanConfidence = static_cast<float>(confidenceSum / track.confidences.size());
+
+    // Most frequent label, the first seen one on a tie
+    QHash<int, int> votes;
+    int best = 0;
+    for (int id : frameLabels[row]) {
+        int count = ++votes[id];
+        if (count > best) {
+            best = count;
+            track.label = labelNames[id];
+        }
+    }
+}
+
+int TrackIndex::labelId(const QString &label)
+{
+    auto it = labelIds.constFind(label);
+    if (it != labelIds.constEnd())
+        return it.value();
+    labelIds.insert(label, labelNames.size());
+    labelNames << label;
+    return labelNames.size() - 1;
+}
+
+void TrackIndex::save(QDataStream &out) const
+{
+    out << labelNames << qint32(tracks.size());
+    for (int row = 0; row < tracks.size(); ++row) {
+        const TrackInfo &track = tracks[row];
+        out << qint32(track.id) << track.label << qint32(track.firstFrame) << qint32(track.lastFrame)
+            << track.minConfidence << track.maxConfidence << track.meanConfidence << track.frames << track.boxes
+            << track.confidences << frameLabels[row];
+    }
+}
+
+bool TrackIndex::load(QDataStream &in)
+{
+    clear();
+    qint32 count = 0;
+    in >> labelNames >> count;
+    for (int i = 0; i < labelNames.size(); ++i)
+        labelIds.insert(labelNames[i], i);
+    for (qint32 i = 0; i < count && in.status() == QDataStream::Ok; ++i) {
+        TrackInfo track;
+        QVector<int> labels;
+        qint32 id = 0, first = 0, last = 0;
+        in >> id >> track.label >> first >> last
+           >> track.minConfidence >> track.maxConfidence >> track.meanConfidence >> track.frames >> track.boxes
+           >> track.confidences >> labels;
+        if (track.frames.isEmpty() || track.boxes.size() != 4 * track.frames.size()
+                || track.confidences.size() != track.frames.size() || labels.size() != track.frames.size())
+            break;
+        bool labelsValid = true;
+        for (int label : labels)
+            labelsValid = labelsValid && label >= 0 && label < labelNames.size();
+        if (!labelsValid)
+            break;
+        track.id = id;
+        track.firstFrame = first;
+        track.lastFrame = last;
+        rowById.insert(track.id, tracks.size());
+        tracks.push_back(track);
+        frameLabels.push_back(labels);
+    }
+    if (in.status() != QDataStream::Ok || tracks.size() != count) {
+        clear();
+        return false;
+    }
+    reportUsage();
+    return true;
+}
+
+void TrackIndex::reportUsage()
+{
+    qint64 bytes = tracks.capacity() * qint64(sizeof(TrackInfo)) + rowById.size() * qint64(2 * sizeof(int));
+    for (const TrackInfo &track : tracks)
+        bytes += track.frames.capacity() * qint64(sizeof(int)) + track.boxes.capacity() * qint64(sizeof(quint16))
+                 + track.confidences.capacity() * qint64(sizeof(float));
+    for (const QVector<int> &labels : frameLabels)
+        bytes += labels.capacity() * qint64(sizeof(int));
+    MemoryBudget::instance().setUsage(budgetHandle, bytes);
+}
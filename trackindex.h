@@ -0,0 +1,77 @@
+#ifndef TRACKINDEX_H
+#define TRACKINDEX_H
+
+#include <QString>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QStringList>
+#include <QRectF>
+#include "annotationparser.h"
+
+class QDataStream;
+
+// One tracker ID over the whole run
+struct TrackInfo {
+    int id = 0;
+    QString label;              // Most frequent label of the track
+    int firstFrame = 0;
+    int lastFrame = 0;
+    float minConfidence = 0;
+    float maxConfidence = 0;
+    float meanConfidence = 0;
+    QVector<int> frames;        // Frames the track appears in, ascending
+    QVector<quint16> boxes;     // xmin, ymin, xmax, ymax per frame, 0..65535 of the frame size
+    QVector<float> confidences; // Per frame
+
+    int frameCount() const { return frames.size(); }
+    int lifetime() const { return lastFrame - firstFrame + 1; }
+    // Normalized box in frames[i]
+    QRectF boxAt(int i) const;
+};
+
+// Tracks by tracker ID, built in one pass over the parser's frames and
+// extended by update() as frames are appended.
+// Frames without an ID (0) are not part of any track.
+class TrackIndex
+{
+public:
+    static const int lifetimeBins = 18;     // Track lifetime in frames, power of two bins
+
+    TrackIndex();
+    ~TrackIndex();
+
+    void build(const AnnotationParser &parser);
+    // Frames from fromFrame on were (re)parsed: drops what the tracks had
+    // from there and reads only those frames again
+    void update(const AnnotationParser &parser, int fromFrame);
+    void clear();
+    // For the video cache; load() leaves the index empty if the data does not fit
+    void save(QDataStream &out) const;
+    bool load(QDataStream &in);
+
+    int size() const { return tracks.size(); }
+    const TrackInfo &track(int row) const { return tracks[row]; }
+    // Row of a tracker ID, -1 if unknown
+    int rowOf(int id) const { return rowById.value(id, -1); }
+    QVector<qint64> lifetimeHistogram() const;
+
+private:
+    // Appends frames from first on, rows that got frames go to changedRows
+    void addFrames(const AnnotationParser &parser, int first, QSet<int> &changedRows);
+    // Label and confidence summary from the track's frames
+    void finishTrack(int row);
+    int labelId(const QString &label);
+    void reportUsage();
+
+    QVector<TrackInfo> tracks;
+    QHash<int, int> rowById;
+    QStringList labelNames;
+    QHash<QString, int> labelIds;
+    QVector<QVector<int>> frameLabels;  // Per track, the label of each frame, so update() can drop frames
+    int budgetHandle;
+
+    Q_DISABLE_COPY(TrackIndex)
+};
+
+#endif // TRACKINDEX_H
@@ -0,0 +1,157 @@
+#include "trackwidget.h"
+#include "videowidget.h"
+#include <QSortFilterProxyModel>
+#include <QTableView>
+#include <QHeaderView>
+#include <QItemSelectionModel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QLabel>
+#include <QHBoxLayout>
+#include <QVBoxLayout>
+
+TrackTableModel::TrackTableModel(VideoWidget *videoWidget, QObject *parent)
+    : QAbstractTableModel(parent),
+      videoWidget(videoWidget)
+{
+}
+
+int TrackTableModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid() || !videoWidget)
+        return 0;
+    return videoWidget->trackIndex().size();
+}
+
+int TrackTableModel::columnCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : ColumnCount;
+}
+
+QVariant TrackTableModel::data(const QModelIndex &index, int role) const
+{
+    if (!videoWidget || !index.isValid() || index.row() >= rowCount())
+        return QVariant();
+    if (role != Qt::DisplayRole && role != Qt::UserRole)
+        return QVariant();
+
+    const TrackInfo &track = videoWidget->trackIndex().track(index.row());
+    bool display = role == Qt::DisplayRole;
+    switch (index.column()) {
+    case IdColumn:       return track.id;
+    case LabelColumn:    return track.label;
+    case FirstColumn:    return track.firstFrame;
+    case LastColumn:     return track.lastFrame;
+    case LifetimeColumn: return track.lifetime();
+    case FramesColumn:   return track.frameCount();
+    case MeanConfColumn: return display ? QVariant(QString::number(track.meanConfidence, 'f', 2)) : QVariant(track.meanConfidence);
+    case MinConfColumn:  return display ? QVariant(QString::number(track.minConfidence, 'f', 2)) : QVariant(track.minConfidence);
+    case MaxConfColumn:  return display ? QVariant(QString::number(track.maxConfidence, 'f', 2)) : QVariant(track.maxConfidence);
+    default:             return QVariant();
+    }
+}
+
+QVariant TrackTableModel::headerData(int section, Qt::Orientation orientation, int role) const
+{
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QAbstractTableModel::headerData(section, orientation, role);
+    static const char *names[ColumnCount] = { "ID", "Label", "First frame", "Last frame", "Lifetime",
+                                              "Frames", "Mean conf", "Min conf", "Max conf" };
+    return section >= 0 && section < ColumnCount ? QString(names[section]) : QVariant();
+}
+
+int TrackTableModel::trackId(int row) const
+{
+    if (!videoWidget || row < 0 || row >= rowCount())
+        return -1;
+    return videoWidget->trackIndex().track(row).id;
+}
+
+void TrackTableModel::reload()
+{
+    beginResetModel();
+    endResetModel();
+}
+
+TrackWidget::TrackWidget(VideoWidget *videoWidget, QWidget *parent)
+    : QWidget(parent),
+      videoWidget(videoWidget)
+{
+    model = new TrackTableModel(videoWidget, this);
+    proxy = new QSortFilterProxyModel(this);
+    proxy->setSourceModel(model);
+    proxy->setSortRole(Qt::UserRole);
+    proxy->setFilterKeyColumn(TrackTableModel::LabelColumn);
+    proxy->setFilterCaseSensitivity(Qt::CaseInsensitive);
+
+    view = new QTableView(this);
+    view->setModel(proxy);
+    view->setSortingEnabled(true);
+    view->sortByColumn(TrackTableModel::LifetimeColumn, Qt::DescendingOrder);
+    view->setSelectionBehavior(QAbstractItemView::SelectRows);
+    view->setSelectionMode(QAbstractItemView::SingleSelection);
+    view->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    view->verticalHeader()->setVisible(false);
+    // Fixed row height, so the view does not measure every row
+    view->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+    view->horizontalHeader()->setSectionResizeMode(QHeaderView::Stretch);
+
+    filterEdit = new QLineEdit(this);
+    filterEdit->setPlaceholderText("Filter by label");
+    stopButton = new QPushButton("Stop track", this);
+    countLabel = new QLabel(this);
+    playingLabel = new QLabel(this);
+
+    QHBoxLayout *topLayout = new QHBoxLayout;
+    topLayout->addWidget(filterEdit);
+    topLayout->addWidget(countLabel);
+    topLayout->addStretch();
+    topLayout->addWidget(playingLabel);
+    topLayout->addWidget(stopButton);
+
+    QVBoxLayout *mainLayout = new QVBoxLayout(this);
+    mainLayout->addLayout(topLayout);
+    mainLayout->addWidget(view);
+    setLayout(mainLayout);
+
+    connect(filterEdit, &QLineEdit::textChanged, proxy, &QSortFilterProxyModel::setFilterFixedString);
+    connect(filterEdit, &QLineEdit::textChanged, this, &TrackWidget::showTrackCount);
+    connect(view->selectionModel(), &QItemSelectionModel::currentRowChanged, this, &TrackWidget::playSelected);
+    connect(view, &QTableView::activated, this, &TrackWidget::playSelected);
+    connect(stopButton, &QPushButton::clicked, this, &TrackWidget::stopTrack);
+    connect(videoWidget, &VideoWidget::annotationsChanged, model, &TrackTableModel::reload);
+    connect(videoWidget, &VideoWidget::annotationsChanged, this, &TrackWidget::showTrackCount);
+    connect(videoWidget, &VideoWidget::trackPlaybackChanged, this, &TrackWidget::showPlayingTrack);
+
+    setWindowTitle("Tracks");
+    resize(800, 500);
+    showTrackCount();
+    showPlayingTrack(-1);
+}
+
+void TrackWidget::playSelected()
+{
+    QModelIndex current = view->currentIndex();
+    if (!videoWidget || !current.isValid())
+        return;
+    int id = model->trackId(proxy->mapToSource(current).row());
+    if (id > 0)
+        videoWidget->playTrack(id);
+}
+
+void TrackWidget::stopTrack()
+{
+    if (videoWidget)
+        videoWidget->stopTrack();
+}
+
+void TrackWidget::showTrackCount()
+{
+    countLabel->setText(QString("%1 of %2 tracks").arg(proxy->rowCount()).arg(model->rowCount()));
+}
+
+void TrackWidget::showPlayingTrack(int trackId)
+{
+    playingLabel->setText(trackId > 0 ? QString("Playing track %1").arg(trackId) : QString());
+    stopButton->setEnabled(trackId > 0);
+}
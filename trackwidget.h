@@ -0,0 +1,68 @@
+#ifndef TRACKWIDGET_H
+#define TRACKWIDGET_H
+
+#include <QWidget>
+#include <QPointer>
+#include <QAbstractTableModel>
+
+class VideoWidget;
+class QSortFilterProxyModel;
+class QTableView;
+class QLineEdit;
+class QPushButton;
+class QLabel;
+
+// Rows are read from the VideoWidget's TrackIndex when the view asks for
+// them, so a run with many tracks costs no item objects.
+class TrackTableModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum Column { IdColumn, LabelColumn, FirstColumn, LastColumn, LifetimeColumn,
+                  FramesColumn, MeanConfColumn, MinConfColumn, MaxConfColumn, ColumnCount };
+
+    explicit TrackTableModel(VideoWidget *videoWidget, QObject *parent = nullptr);
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    // Qt::UserRole is the raw value, used for sorting
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+    int trackId(int row) const;
+
+public slots:
+    void reload();
+
+private:
+    QPointer<VideoWidget> videoWidget;
+};
+
+// Track list of the video in a VideoWidget. Selecting a track plays only
+// the frames it appears in.
+class TrackWidget : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit TrackWidget(VideoWidget *videoWidget, QWidget *parent = nullptr);
+
+private slots:
+    void playSelected();
+    void stopTrack();
+    void showTrackCount();
+    void showPlayingTrack(int trackId);
+
+private:
+    QPointer<VideoWidget> videoWidget;
+    TrackTableModel *model;
+    QSortFilterProxyModel *proxy;
+    QTableView *view;
+    QLineEdit *filterEdit;
+    QPushButton *stopButton;
+    QLabel *countLabel;
+    QLabel *playingLabel;
+};
+
+#endif // TRACKWIDGET_H
@@ -0,0 +1,199 @@
+#include "videocache.h"
+#include "decodebackend.h"
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QDateTime>
+#include <QSaveFile>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QCryptographicHash>
+#include <QPainter>
+#include <QThread>
+#include <algorithm>
+
+namespace {
+
+const int maxThumbnails = 1000;
+const int atlasColumns = 32;
+const QSize thumbnailBox(128, 72);
+// Bytes hashed at the start, middle and end of the file
+const qint64 hashSampleBytes = 1024 * 1024;
+
+} // namespace
+
+QString VideoCache::cacheKey(const QString &videoPath)
+{
+    QFileInfo fi(videoPath);
+    QFile file(videoPath);
+    if (!fi.exists() || !file.open(QIODevice::ReadOnly))
+        return QString();
+
+    // Hashing a multi-GB file would take longer than opening it, so only sample it
+    QCryptographicHash hash(QCryptographicHash::Sha1);
+    hash.addData(QByteArray::number(fi.size()));
+    hash.addData(QByteArray::number(fi.lastModified().toMSecsSinceEpoch()));
+    const qint64 offsets[] = { 0, fi.size() / 2, std::max<qint64>(0, fi.size() - hashSampleBytes) };
+    for (qint64 offset : offsets) {
+        file.seek(offset);
+        hash.addData(file.read(hashSampleBytes));
+    }
+    return QString::fromLatin1(hash.result().toHex());
+}
+
+bool VideoCache::open(const QString &path)
+{
+    close();
+    QString key = cacheKey(path);
+    if (key.isEmpty())
+        return false;
+
+    QString cacheDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation)
+                       + "/videos/" + key;
+    if (!QDir().mkpath(cacheDir))
+        return false;
+    dir = cacheDir;
+    videoPath = path;
+    return true;
+}
+
+void VideoCache::close()
+{
+    dir.clear();
+    videoPath.clear();
+    atlas = QImage();
+    thumbSize = QSize();
+    thumbInterval = 0;
+    thumbColumns = 0;
+    thumbCount = 0;
+}
+
+int VideoCache::lastFrame() const
+{
+    if (!isOpen())
+        return -1;
+    QSettings session(dir + "/session.ini", QSettings::IniFormat);
+    return session.value("lastFrame", -1).toInt();
+}
+
+QImage VideoCache::lastFrameImage() const
+{
+    if (!isOpen())
+        return QImage();
+    return QImage(dir + "/last.jpg");
+}
+
+void VideoCache::saveSession(int frameIdx, const QImage &frameImage)
+{
+    if (!isOpen())
+        return;
+    QSettings session(dir + "/session.ini", QSettings::IniFormat);
+    session.setValue("video", videoPath);
+    session.setValue("lastFrame", frameIdx);
+    if (!frameImage.isNull())
+        frameImage.save(dir + "/last.jpg", "JPG", 90);
+}
+
+bool VideoCache::saveIndex(const QString &name, const QByteArray &data) const
+{
+    if (!isOpen())
+        return false;
+    QSaveFile file(dir + "/" + name + ".idx");
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+    file.write(data);
+    return file.commit();
+}
+
+QByteArray VideoCache::loadIndex(const QString &name) const
+{
+    if (!isOpen())
+        return QByteArray();
+    QFile file(dir + "/" + name + ".idx");
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return file.readAll();
+}
+
+bool VideoCache::buildThumbnails(const std::atomic<bool> &cancel) const
+{
+    if (!isOpen())
+        return false;
+
+    // Few threads, this runs next to playback
+    std::unique_ptr<DecodeBackend> decoder = DecodeBackend::openFile(videoPath, DecodeBackend::RGB,
+                                                                     std::max(1, QThread::idealThreadCount() / 4));
+    int total = decoder->frameCount();
+    QSize size = decoder->frameSize().scaled(thumbnailBox, Qt::KeepAspectRatio);
+    if (!decoder->isOpened() || total <= 0 || size.isEmpty())
+        return false;
+    decoder->setOutputSize(size);
+
+    int interval = std::max(1, (total + maxThumbnails - 1) / maxThumbnails);
+    int count = (total + interval - 1) / interval;
+    int columns = std::min(count, atlasColumns);
+    int rows = (count + columns - 1) / columns;
+    QImage atlasImage(columns * size.width(), rows * size.height(), QImage::Format_RGB32);
+    atlasImage.fill(Qt::black);
+
+    // Sequential decode: grab() the frames in between, only sampled ones are converted
+    int written = 0;
+    {
+        QPainter painter(&atlasImage);
+        for (int idx = 0; idx < total && written < count; ++idx) {
+            if (cancel.load())
+                return false;
+            if (idx % interval != 0) {
+                if (!decoder->grab())
+                    break;
+                continue;
+            }
+            cv::Mat frame;
+            if (!decoder->read(frame))
+                break;
+            QImage thumb(frame.data, frame.cols, frame.rows, static_cast<int>(frame.step), QImage::Format_RGB888);
+            painter.drawImage(QPoint((written % columns) * size.width(), (written / columns) * size.height()), thumb);
+            ++written;
+        }
+    }
+    if (written == 0 || !atlasImage.save(dir + "/thumbs.jpg", "JPG", 85))
+        return false;
+
+    QSettings meta(dir + "/thumbs.ini", QSettings::IniFormat);
+    meta.setValue("interval", interval);
+    meta.setValue("width", size.width());
+    meta.setValue("height", size.height());
+    meta.setValue("columns", columns);
+    meta.setValue("count", written);
+    meta.sync();
+    return meta.status() == QSettings::NoError;
+}
+
+bool VideoCache::loadThumbnails()
+{
+    if (!isOpen())
+        return false;
+    QSettings meta(dir + "/thumbs.ini", QSettings::IniFormat);
+    int count = meta.value("count", 0).toInt();
+    if (count <= 0)
+        return false;
+    QImage image(dir + "/thumbs.jpg");
+    if (image.isNull())
+        return false;
+
+    atlas = image;
+    thumbInterval = std::max(1, meta.value("interval", 1).toInt());
+    thumbSize = QSize(meta.value("width").toInt(), meta.value("height").toInt());
+    thumbColumns = std::max(1, meta.value("columns", 1).toInt());
+    thumbCount = count;
+    return true;
+}
+
+QImage VideoCache::thumbnail(int frameIdx) const
+{
+    if (atlas.isNull() || frameIdx < 0)
+        return QImage();
+    int slot = std::min(frameIdx / thumbInterval, thumbCount - 1);
+    return atlas.copy(QRect(QPoint((slot % thumbColumns) * thumbSize.width(),
+                                   (slot / thumbColumns) * thumbSize.height()), thumbSize));
+}
@@ -0,0 +1,54 @@
+#ifndef VIDEOCACHE_H
+#define VIDEOCACHE_H
+
+#include <QString>
+#include <QImage>
+#include <QByteArray>
+#include <QSize>
+#include <atomic>
+
+// Cache directory of one video, kept between runs. Keyed by file size,
+// mtime and a hash of sampled file content, it holds a low-res thumbnail
+// atlas, the last viewed frame and any indexes computed for the video.
+class VideoCache
+{
+public:
+    VideoCache() {}
+
+    bool open(const QString &videoPath);
+    void close();
+    bool isOpen() const { return !dir.isEmpty(); }
+    QString directory() const { return dir; }
+
+    // Where the video was left, -1 if never viewed
+    int lastFrame() const;
+    QImage lastFrameImage() const;
+    void saveSession(int frameIdx, const QImage &frameImage);
+
+    bool saveIndex(const QString &name, const QByteArray &data) const;
+    QByteArray loadIndex(const QString &name) const;
+
+    // Decodes the video once, front to back, and writes the thumbnail atlas.
+    // Runs on a worker thread; returns false if cancelled or failed.
+    bool buildThumbnails(const std::atomic<bool> &cancel) const;
+    bool loadThumbnails();
+    bool hasThumbnails() const { return !atlas.isNull(); }
+    qint64 thumbnailBytes() const { return qint64(atlas.bytesPerLine()) * atlas.height(); }
+    // Drops the loaded atlas under memory pressure, loadThumbnails() brings it back
+    void unloadThumbnails() { atlas = QImage(); }
+    // Thumbnail of the nearest sampled frame at or before frameIdx
+    QImage thumbnail(int frameIdx) const;
+
+    static QString cacheKey(const QString &videoPath);
+
+private:
+    QString dir;
+    QString videoPath;
+    QImage atlas;
+    QSize thumbSize;
+    int thumbInterval = 0;
+    int thumbColumns = 0;
+    int thumbCount = 0;
+};
+
+#endif // VIDEOCACHE_H
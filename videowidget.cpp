@@ -1,4 +1,5 @@
 #include "videowidget.h"
+#include "memorybudget.h"
 #include <QLabel>
 #include <QVBoxLayout>
 #include <QSlider>
@@ -8,7 +9,136 @@
 #include <QDir>
 #include <QPainter>
 #include <QFont>
+#include <QRunnable>
+#include <QThread>
+#include <QWheelEvent>
+#include <QMouseEvent>
+#include <QStyle>
+#include <QFileSystemWatcher>
+#include <QMutexLocker>
+#include <QDataStream>
+#include <QDateTime>
 #include <sstream>
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// At high rates only this many frames per second are shown, the rest skipped
+const int maxPresentFps = 60;
+// Memory for one reverse block (two are alive while prefetching), less when the budget is short
+const qint64 reverseBlockBytes = 128 * 1024 * 1024;
+const double minPlaybackRate = 0.25;
+const double maxPlaybackRate = 8.0;
+const double maxZoom = 16.0;
+// Zoomed views are built from square tiles of the native frame
+const int zoomTileSize = 256;
+// Annotation statistics and tracks in the video cache
+const char annotationIndexName[] = "annotations";
+const qint32 annotationIndexVersion = 2;
+
+// Seeks once to the start of the block and decodes forward to lastIdx,
+// keeping every step-th frame counted back from lastIdx.
+void decodeReverseBlock(DecodeBackend &decoder, int lastIdx, int step, int maxFrames, FrameBlock &block)
+{
+    block = FrameBlock();
+    int first = std::max(0, lastIdx - (maxFrames - 1) * step);
+    first = lastIdx - ((lastIdx - first) / step) * step;
+    if (!decoder.skipTo(first))
+        return;
+
+    for (int f = first; f <= lastIdx; ++f) {
+        if ((lastIdx - f) % step == 0) {
+            cv::Mat frame;
+            if (!decoder.read(frame))
+                break;
+            block.frames.insert(f, frame);
+        } else if (!decoder.grab()) {
+            break;
+        }
+    }
+    if (!block.frames.isEmpty()) {
+        block.first = block.frames.firstKey();
+        block.last = block.frames.lastKey();
+        block.step = step;
+    }
+}
+
+// Builds the thumbnail atlas of the cache, then tells the widget to load it
+class ThumbnailTask : public QRunnable
+{
+public:
+    ThumbnailTask(const VideoCache *cache, const std::atomic<bool> *cancel, QObject *receiver)
+        : cache(cache), cancel(cancel), receiver(receiver) {}
+
+    void run() override
+    {
+        if (cache->buildThumbnails(*cancel))
+            QMetaObject::invokeMethod(receiver, "thumbnailsReady", Qt::QueuedConnection);
+    }
+
+private:
+    const VideoCache *cache;
+    const std::atomic<bool> *cancel;
+    QObject *receiver;
+};
+
+class ReverseBlockTask : public QRunnable
+{
+public:
+    ReverseBlockTask(DecodeBackend *decoder, int lastIdx, int step, int maxFrames, FrameBlock *block,
+                     QObject *receiver)
+        : decoder(decoder), lastIdx(lastIdx), step(step), maxFrames(maxFrames), block(block), receiver(receiver) {}
+
+    void run() override
+    {
+        decodeReverseBlock(*decoder, lastIdx, step, maxFrames, *block);
+        // The block now holds what it really decoded
+        QMetaObject::invokeMethod(receiver, "reportMemory", Qt::QueuedConnection);
+    }
+
+private:
+    DecodeBackend *decoder;
+    int lastIdx;
+    int step;
+    int maxFrames;
+    FrameBlock *block;
+    QObject *receiver;
+};
+
+// Decodes the scattered frames of a track ahead of playback. Close frames
+// are reached by grabbing forward, far ones by seeking.
+class PlaylistPrefetchTask : public QRunnable
+{
+public:
+    PlaylistPrefetchTask(DecodeBackend *decoder, const QVector<int> &frames, QMutex *mutex,
+                         QMap<int, cv::Mat> *cache, const std::atomic<bool> *cancel, QObject *receiver)
+        : decoder(decoder), frames(frames), mutex(mutex), cache(cache), cancel(cancel), receiver(receiver) {}
+
+    void run() override
+    {
+        for (int frameIdx : frames) {
+            if (cancel->load())
+                return;
+            cv::Mat frame;
+            if (!decoder->readFrame(frameIdx, frame))
+                continue;
+            QMutexLocker locker(mutex);
+            cache->insert(frameIdx, frame);
+        }
+        QMetaObject::invokeMethod(receiver, "reportMemory", Qt::QueuedConnection);
+    }
+
+private:
+    DecodeBackend *decoder;
+    QVector<int> frames;
+    QMutex *mutex;
+    QMap<int, cv::Mat> *cache;
+    const std::atomic<bool> *cancel;
+    QObject *receiver;
+};
+
+} // namespace
 
 VideoWidget::VideoWidget(QWidget *parent)
     : QWidget(parent),
@@ -18,73 +148,308 @@ VideoWidget::VideoWidget(QWidget *parent)
       fps(30),
       playing(false),
       currentFrameIdx(0),
-      totalFrames(0)
+      totalFrames(0),
+      resizeTimer(new QTimer(this)),
+      rate(1.0),
+      reverse(false),
+      playlistPos(-1),
+      playlistTrackId(-1),
+      playlistPrefetchedTo(0),
+      playlistCancel(false),
+      zoom(1.0),
+      viewCenter(0.5, 0.5),
+      panning(false),
+      baseFrameIdx(-1),
+      overlayTimer(new QTimer(this)),
+      tileCacheFrameIdx(-1),
+      tileCacheBytes(0),
+      thumbnailCancel(false),
+      previewPopup(new QLabel(this, Qt::ToolTip)),
+      annotationWatcher(new QFileSystemWatcher(this)),
+      annotationFileSize(-1),
+      annotationFileTime(0),
+      annotationIndexesDirty(false)
 {
     label->setAlignment(Qt::AlignCenter);
+    // Follows the window, frames are decoded to fit it
+    label->setSizePolicy(QSizePolicy::Ignored, QSizePolicy::Ignored);
 
     QVBoxLayout *layout = new QVBoxLayout(this);
     layout->addWidget(label);
     layout->addWidget(frameSlider);
     setLayout(layout);
 
+    timer->setTimerType(Qt::PreciseTimer);
     connect(timer, &QTimer::timeout, this, &VideoWidget::timerNextFrame);
 
+    // A slider drag sends many values per event loop pass, only the last is drawn
+    overlayTimer->setSingleShot(true);
+    overlayTimer->setInterval(0);
+    connect(overlayTimer, &QTimer::timeout, this, &VideoWidget::composeOverlay);
+
+    // A window drag resizes many times, the decoder follows when it stops
+    resizeTimer->setSingleShot(true);
+    resizeTimer->setInterval(100);
+    connect(resizeTimer, &QTimer::timeout, this, &VideoWidget::decodeAtViewSize);
+
+    // One background decoder for the reverse block prefetch
+    reversePool.setMaxThreadCount(1);
+    playlistPool.setMaxThreadCount(1);
+    thumbnailPool.setMaxThreadCount(1);
+
     frameSlider->setMinimum(0);
     frameSlider->setMaximum(0);
     frameSlider->setValue(0);
     frameSlider->setEnabled(false);
 
     connect(frameSlider, &QSlider::valueChanged, this, &VideoWidget::setFrameFromSlider);
+
+    // Detection may still be writing the annotation file
+    connect(annotationWatcher, &QFileSystemWatcher::fileChanged, this, &VideoWidget::reloadAnnotations);
+
+    // Thumbnail previews while hovering the slider
+    frameSlider->setMouseTracking(true);
+    frameSlider->installEventFilter(this);
+
+    MemoryBudget &budget = MemoryBudget::instance();
+    framesBudget = budget.addConsumer(MemoryBudget::DecodedFrames, [this](qint64) { return evictDecodedFrames(); });
+    tilesBudget = budget.addConsumer(MemoryBudget::Tiles, [this](qint64) { return evictTiles(); });
+    thumbnailsBudget = budget.addConsumer(MemoryBudget::Thumbnails, [this](qint64) { return evictThumbnails(); });
 }
 
 VideoWidget::~VideoWidget()
 {
+    MemoryBudget &budget = MemoryBudget::instance();
+    budget.removeConsumer(framesBudget);
+    budget.removeConsumer(tilesBudget);
+    budget.removeConsumer(thumbnailsBudget);
     timer->stop();
-    if (cap.isOpened())
-        cap.release();
+    saveSession();
+    stopThumbnails();
+    stopReverseDecode();
+    stopPlaylistPrefetch();
+    playlistDecoder.reset();
+    if (decoder)
+        decoder->close();
 }
 
 void VideoWidget::setVideo(const QString &filePath)
 {
-    if (cap.isOpened())
-        cap.release();
+    saveSession();
+    stopThumbnails();
+    stopReverseDecode();
+    stopTrack();
+    playlistDecoder.reset();
+    clearTileCache();
+    basePixmap = QPixmap();
+    baseFrameIdx = -1;
+    baseAnnotations.reset();
+    zoom = 1.0;
+    viewCenter = QPointF(0.5, 0.5);
+
+    // Reopened video: show where it was left at once, before the decoder is up
+    int startFrame = 0;
+    if (videoCache.open(filePath)) {
+        QImage lastImage = videoCache.lastFrameImage();
+        if (!lastImage.isNull()) {
+            label->setPixmap(QPixmap::fromImage(lastImage));
+            label->repaint();
+        }
+        startFrame = std::max(0, videoCache.lastFrame());
+    }
 
-    cap.open(filePath.toStdString());
+    // Frames come out as RGB, ready for display
+    decoder = DecodeBackend::openFile(filePath, DecodeBackend::RGB, QThread::idealThreadCount());
     loadedFile = filePath;
+    // swscale scales straight to the view, no second scale of a native frame
+    decodeSize = label->size();
+    decoder->setOutputSize(decodeSize);
 
-    // Load annotation file (assume .txt extension)
-    QString annotFile = filePath;
-    annotFile.chop(4); // Remove ".mp4"
-    annotFile += ".txt";
+    // Load annotation file (.qann export or .txt next to the video)
+    QString annotFile = AnnotationParser::annotationFileFor(filePath);
+    setAnnotationIndexKey(annotFile);
     bool annLoaded = annotationParser.loadFromFile(annotFile);
+    // Statistics and tracks of an unchanged file come from the cache instead of a full pass
+    if (!annLoaded || !loadAnnotationIndexes()) {
+        annotationStats.compute(annotationParser);
+        tracks.build(annotationParser);
+        annotationIndexesDirty = annLoaded;
+        saveAnnotationIndexes();
+    }
+    if (!annotationWatcher->files().isEmpty())
+        annotationWatcher->removePaths(annotationWatcher->files());
+    if (annLoaded)
+        annotationWatcher->addPath(annotFile);
+    emit annotationsChanged();
    /* if (!annLoaded) {
         qDebug() << "Annotation file not loaded:" << annotFile;
         // Optionally show a message or fallback behavior
     }*/
 
-    if (!cap.isOpened()) {
+    if (!decoder->isOpened()) {
         label->setText("Failed to open video.");
         frameSlider->setEnabled(false);
         return;
     }
 
-    fps = static_cast<int>(cap.get(cv::CAP_PROP_FPS));
-    totalFrames = static_cast<int>(cap.get(cv::CAP_PROP_FRAME_COUNT));
+    fps = static_cast<int>(decoder->fps() + 0.5);
+    if (fps <= 0)
+        fps = 30;
+    totalFrames = decoder->frameCount();
 
     setSliderRange();
 
-    currentFrameIdx = 0;
-    frameSlider->setValue(0);
+    if (startFrame >= totalFrames)
+        startFrame = 0;
+    currentFrameIdx = startFrame;
+    updateSlider();
 
     cv::Mat frame;
-    if (cap.read(frame) && !frame.empty()) {
-        currentFrameOrig = frame.clone();
+    if (readFrameAt(startFrame, frame)) {
+        currentFrameOrig = frame;
         showFrame(frame, currentFrameIdx);
         frameSlider->setEnabled(true);
     } else {
         label->setText("Failed to read first frame.");
         frameSlider->setEnabled(false);
     }
+
+    if (videoCache.isOpen() && !videoCache.loadThumbnails())
+        startThumbnails();
+    reportMemory();
+}
+
+void VideoWidget::reloadAnnotations()
+{
+    // Writers that replace the file drop it from the watcher
+    QString annotFile = annotationParser.fileName();
+    if (!annotFile.isEmpty() && QFileInfo::exists(annotFile) && !annotationWatcher->files().contains(annotFile))
+        annotationWatcher->addPath(annotFile);
+
+    int firstChanged = -1;
+    setAnnotationIndexKey(annotFile);
+    if (!annotationParser.loadAppended(&firstChanged))
+        return;
+    // Only the blocks from the first changed frame on are recomputed
+    if (firstChanged < 0)
+        annotationStats.compute(annotationParser);
+    else
+        annotationStats.update(annotationParser, firstChanged);
+    // Tracks likewise only read the frames from there on
+    if (firstChanged < 0)
+        tracks.build(annotationParser);
+    else
+        tracks.update(annotationParser, firstChanged);
+    // Saved with the session, not on every append
+    annotationIndexesDirty = true;
+    // Only the overlay changed, redraw it over the cached frame
+    if (baseFrameIdx >= firstChanged) {
+        baseAnnotations = annotationParser.getAnnotations(baseFrameIdx);
+        overlayTimer->start();
+    }
+    emit annotationsChanged();
+}
+
+void VideoWidget::setAnnotationIndexKey(const QString &annotFile)
+{
+    // Taken before parsing: a file still growing meanwhile gets a key that misses next time
+    QFileInfo fi(annotFile);
+    annotationFileSize = fi.exists() ? fi.size() : -1;
+    annotationFileTime = fi.exists() ? fi.lastModified().toMSecsSinceEpoch() : 0;
+}
+
+bool VideoWidget::loadAnnotationIndexes()
+{
+    QByteArray data = videoCache.loadIndex(annotationIndexName);
+    if (data.isEmpty() || annotationFileSize < 0)
+        return false;
+    QDataStream in(data);
+    in.setVersion(QDataStream::Qt_5_0);
+    qint32 version = 0;
+    QString fileName;
+    qint64 size = -1, time = 0;
+    in >> version >> fileName >> size >> time;
+    if (in.status() != QDataStream::Ok || version != annotationIndexVersion
+            || fileName != QFileInfo(annotationParser.fileName()).absoluteFilePath()
+            || size != annotationFileSize || time != annotationFileTime)
+        return false;
+    if (!annotationStats.load(in) || !tracks.load(in)) {
+        annotationStats.clear();
+        tracks.clear();
+        return false;
+    }
+    annotationIndexesDirty = false;
+    return true;
+}
+
+void VideoWidget::saveAnnotationIndexes()
+{
+    if (!annotationIndexesDirty || !videoCache.isOpen() || annotationFileSize < 0)
+        return;
+    QByteArray data;
+    QDataStream out(&data, QIODevice::WriteOnly);
+    out.setVersion(QDataStream::Qt_5_0);
+    out << annotationIndexVersion << QFileInfo(annotationParser.fileName()).absoluteFilePath()
+        << annotationFileSize << annotationFileTime;
+    annotationStats.save(out);
+    tracks.save(out);
+    if (videoCache.saveIndex(annotationIndexName, data))
+        annotationIndexesDirty = false;
+}
+
+void VideoWidget::saveSession()
+{
+    saveAnnotationIndexes();
+    if (!videoCache.isOpen() || currentFrameOrig.empty())
+        return;
+    // Stored at display size, so it can be shown as is on the next open
+    QImage img(currentFrameOrig.data, currentFrameOrig.cols, currentFrameOrig.rows,
+               static_cast<int>(currentFrameOrig.step), QImage::Format_RGB888);
+    QSize size = displayedSize.isEmpty() ? QSize(640, 360) : displayedSize;
+    videoCache.saveSession(currentFrameIdx, img.scaled(size, Qt::KeepAspectRatio, Qt::SmoothTransformation));
+}
+
+void VideoWidget::startThumbnails()
+{
+    thumbnailCancel = false;
+    thumbnailPool.start(new ThumbnailTask(&videoCache, &thumbnailCancel, this));
+}
+
+void VideoWidget::stopThumbnails()
+{
+    thumbnailCancel = true;
+    thumbnailPool.waitForDone();
+    thumbnailCancel = false;
+    previewPopup->hide();
+}
+
+void VideoWidget::thumbnailsReady()
+{
+    videoCache.loadThumbnails();
+    reportMemory();
+}
+
+bool VideoWidget::eventFilter(QObject *watched, QEvent *event)
+{
+    // Slider hover shows the cached thumbnail, the decoder is not touched
+    if (watched == frameSlider) {
+        if (event->type() == QEvent::MouseMove && videoCache.hasThumbnails() && frameSlider->isEnabled()) {
+            QMouseEvent *mouseEvent = static_cast<QMouseEvent*>(event);
+            int frameIdx = QStyle::sliderValueFromPosition(frameSlider->minimum(), frameSlider->maximum(),
+                                                           mouseEvent->pos().x(), frameSlider->width());
+            QImage thumb = videoCache.thumbnail(frameIdx);
+            if (!thumb.isNull()) {
+                previewPopup->setPixmap(QPixmap::fromImage(thumb));
+                previewPopup->adjustSize();
+                previewPopup->move(frameSlider->mapToGlobal(
+                    QPoint(mouseEvent->pos().x() - previewPopup->width() / 2, -previewPopup->height() - 4)));
+                previewPopup->show();
+            }
+        } else if (event->type() == QEvent::Leave) {
+            previewPopup->hide();
+        }
+    }
+    return QWidget::eventFilter(watched, event);
 }
 
 void VideoWidget::setSliderRange()
@@ -95,65 +460,76 @@ void VideoWidget::setSliderRange()
 
 void VideoWidget::setFrameFromSlider(int frameNumber)
 {
-    if (!cap.isOpened())
+    if (!decoder || !decoder->isOpened())
         return;
 
     if (playing) pause();
+    stopTrack();
 
     if (frameNumber == currentFrameIdx)
         return;
 
-    cap.set(cv::CAP_PROP_POS_FRAMES, frameNumber);
     cv::Mat frame;
-    if (!cap.read(frame) || frame.empty()) {
+    if (!readFrameAt(frameNumber, frame)) {
         label->setText("Failed to read frame.");
         return;
     }
     currentFrameIdx = frameNumber;
-    currentFrameOrig = frame.clone();
+    currentFrameOrig = frame;
     showFrame(frame, currentFrameIdx);
 }
 
 void VideoWidget::nextFrame()
 {
-    if (!cap.isOpened())
+    if (!decoder || !decoder->isOpened())
         return;
 
     //if (playing) pause();
 
+    if (!playlist.isEmpty()) {
+        if (playlistPos + 1 < playlist.size())
+            showPlaylistPos(playlistPos + 1);
+        return;
+    }
+
     int goTo = currentFrameIdx + 1;
     if (goTo >= totalFrames)
         goTo = totalFrames - 1;
-    cap.set(cv::CAP_PROP_POS_FRAMES, goTo);
     cv::Mat frame;
-    if (!cap.read(frame) || frame.empty()) {
+    if (!readFrameAt(goTo, frame)) {
         label->setText("Failed to read frame.");
         return;
     }
     currentFrameIdx = goTo;
-    currentFrameOrig = frame.clone();
+    currentFrameOrig = frame;
     showFrame(frame, currentFrameIdx);
     updateSlider();
 }
 
 void VideoWidget::prevFrame()
 {
-    if (!cap.isOpened())
+    if (!decoder || !decoder->isOpened())
         return;
 
     if (playing) pause();
 
+    if (!playlist.isEmpty()) {
+        if (playlistPos > 0)
+            showPlaylistPos(playlistPos - 1);
+        return;
+    }
+
     int goTo = currentFrameIdx - 1;
     if (goTo < 0)
         goTo = 0;
-    cap.set(cv::CAP_PROP_POS_FRAMES, goTo);
+    // Served from the reverse block, so stepping back does not seek every frame
     cv::Mat frame;
-    if (!cap.read(frame) || frame.empty()) {
+    if (!reverseFrameAt(goTo, 1, frame)) {
         label->setText("Failed to read frame.");
         return;
     }
     currentFrameIdx = goTo;
-    currentFrameOrig = frame.clone();
+    currentFrameOrig = frame;
     showFrame(frame, currentFrameIdx);
     updateSlider();
 }
@@ -177,27 +553,558 @@ void VideoWidget::saveCurrentFrame()
     QString defaultName = QString("%1_%2.jpg").arg(baseName).arg(currentFrameIdx, 6, 10, QChar('0'));
 
     QString outFile = QDir::current().absoluteFilePath(defaultName);
-    cv::imwrite(outFile.toStdString(), currentFrameOrig); // BGR!
+    // The shown frame may be decoded at view size, save it at native resolution
+    cv::Mat native = currentFrameOrig;
+    if (decoder && decoder->isOpened() && decodeSize.isValid()) {
+        decoder->setOutputSize(QSize());
+        cv::Mat frame;
+        if (readFrameAt(currentFrameIdx, frame))
+            native = frame;
+        decoder->setOutputSize(decodeSize);
+    }
+    cv::Mat bgr;
+    cv::cvtColor(native, bgr, cv::COLOR_RGB2BGR); // imwrite wants BGR!
+    cv::imwrite(outFile.toStdString(), bgr);
     emit frameSaved(outFile);
 }
 
+bool VideoWidget::readFrameAt(int frameIdx, cv::Mat &frame)
+{
+    // Sequential reads continue the decoder, only jumps seek
+    return decoder->readFrame(frameIdx, frame);
+}
+
+bool VideoWidget::reverseFrameAt(int frameIdx, int step, cv::Mat &frame)
+{
+    if (!reverseBlock.frames.contains(frameIdx)) {
+        // Take the prefetched block if it has the frame, else decode it here
+        reversePool.waitForDone();
+        if (reversePrefetch.frames.contains(frameIdx)) {
+            reverseBlock = reversePrefetch;
+        } else {
+            decodeReverseBlock(*decoder, frameIdx, step, reverseBlockFrames(), reverseBlock);
+        }
+        reversePrefetch = FrameBlock();
+        reportMemory();
+    }
+
+    auto it = reverseBlock.frames.constFind(frameIdx);
+    if (it == reverseBlock.frames.constEnd())
+        return false;
+    frame = it.value();
+
+    prefetchReverseBlock();
+    return true;
+}
+
+void VideoWidget::prefetchReverseBlock()
+{
+    // While this block is shown, decode the one before it on reversePool
+    if (reverseBlock.first <= 0 || !reversePool.waitForDone(0))
+        return;
+    int lastIdx = reverseBlock.first - reverseBlock.step;
+    if (lastIdx < 0 || reversePrefetch.frames.contains(lastIdx))
+        return;
+
+    if (!reverseDecoder) {
+        // Threads split with the main decoder, both run at the same time
+        reverseDecoder = DecodeBackend::openFile(loadedFile, DecodeBackend::RGB,
+                                                 std::max(1, QThread::idealThreadCount() / 2));
+        reverseDecoder->setOutputSize(decodeSize);
+    }
+    if (!reverseDecoder->isOpened())
+        return;
+    reversePrefetch = FrameBlock();
+    reversePool.start(new ReverseBlockTask(reverseDecoder.get(), lastIdx, reverseBlock.step,
+                                           reverseBlockFrames(), &reversePrefetch, this));
+    reportMemory();
+}
+
+void VideoWidget::stopReverseDecode()
+{
+    reversePool.waitForDone();
+    reverseDecoder.reset();
+    reverseBlock = FrameBlock();
+    reversePrefetch = FrameBlock();
+    reportMemory();
+}
+
+qint64 VideoWidget::frameBytes() const
+{
+    return currentFrameOrig.empty() ? qint64(1920 * 1080 * 3)
+                                    : qint64(currentFrameOrig.total() * currentFrameOrig.elemSize());
+}
+
+int VideoWidget::reverseBlockFrames() const
+{
+    // Bounded by memory, and about two seconds is enough to hide the seek
+    qint64 bytes = std::min(reverseBlockBytes, MemoryBudget::instance().available() / 2);
+    int frames = static_cast<int>(bytes / frameBytes());
+    return std::max(8, std::min(frames, 2 * fps));
+}
+
+void VideoWidget::playTrack(int trackId)
+{
+    int row = tracks.rowOf(trackId);
+    if (!decoder || !decoder->isOpened() || row < 0)
+        return;
+
+    stopPlaylistPrefetch();
+    playlist = tracks.track(row).frames;
+    playlistTrackId = trackId;
+    playlistPos = -1;
+    playlistPrefetchedTo = 0;
+    setReverse(false);
+    emit trackPlaybackChanged(trackId);
+
+    if (showPlaylistPos(0))
+        play();
+}
+
+void VideoWidget::stopTrack()
+{
+    if (playlist.isEmpty())
+        return;
+    stopPlaylistPrefetch();
+    playlist.clear();
+    playlistTrackId = -1;
+    playlistPos = -1;
+    playlistPrefetchedTo = 0;
+    // Redraw without the track trail
+    composeOverlay();
+    emit trackPlaybackChanged(-1);
+}
+
+bool VideoWidget::showPlaylistPos(int pos)
+{
+    cv::Mat frame;
+    if (!playlistFrameAt(pos, frame)) {
+        label->setText("Failed to read frame.");
+        return false;
+    }
+    playlistPos = pos;
+    currentFrameIdx = playlist[pos];
+    currentFrameOrig = frame;
+    showFrame(frame, currentFrameIdx);
+    updateSlider();
+    prefetchPlaylist();
+    return true;
+}
+
+bool VideoWidget::playlistFrameAt(int pos, cv::Mat &frame)
+{
+    int frameIdx = playlist[pos];
+    {
+        QMutexLocker locker(&playlistMutex);
+        // Frames before this one are not needed any more
+        while (!playlistCache.isEmpty() && playlistCache.firstKey() < frameIdx)
+            playlistCache.erase(playlistCache.begin());
+        auto it = playlistCache.find(frameIdx);
+        if (it != playlistCache.end()) {
+            frame = it.value();
+            playlistCache.erase(it);
+            return true;
+        }
+    }
+    // Not prefetched (first frame, stepping back, or prefetch behind): decode here
+    return readFrameAt(frameIdx, frame);
+}
+
+void VideoWidget::prefetchPlaylist()
+{
+    // One chunk at a time, the next is queued once half of the window is played
+    int window = playlistPrefetchFrames();
+    int from = std::max(playlistPrefetchedTo, playlistPos + 1);
+    int to = std::min(playlist.size(), playlistPos + 1 + window);
+    if (from >= to || from > playlistPos + 1 + window / 2 || !playlistPool.waitForDone(0))
+        return;
+
+    if (!playlistDecoder) {
+        // Threads split with the main decoder, both run at the same time
+        playlistDecoder = DecodeBackend::openFile(loadedFile, DecodeBackend::RGB,
+                                                  std::max(1, QThread::idealThreadCount() / 2));
+        playlistDecoder->setOutputSize(decodeSize);
+    }
+    if (!playlistDecoder->isOpened())
+        return;
+    playlistPool.start(new PlaylistPrefetchTask(playlistDecoder.get(), playlist.mid(from, to - from),
+                                                &playlistMutex, &playlistCache, &playlistCancel, this));
+    playlistPrefetchedTo = to;
+    reportMemory();
+}
+
+void VideoWidget::stopPlaylistPrefetch()
+{
+    playlistCancel = true;
+    playlistPool.waitForDone();
+    playlistCancel = false;
+    {
+        QMutexLocker locker(&playlistMutex);
+        playlistCache.clear();
+    }
+    reportMemory();
+}
+
+int VideoWidget::playlistPrefetchFrames() const
+{
+    // About a second ahead, bounded by the same memory as a reverse block
+    qint64 bytes = std::min(reverseBlockBytes, MemoryBudget::instance().available() / 2);
+    int frames = static_cast<int>(bytes / frameBytes());
+    return std::max(8, std::min(frames, fps));
+}
+
+void VideoWidget::reportMemory()
+{
+    qint64 frames = reverseBlock.frames.size();
+    // The prefetch task fills its block unlocked: counted as full while it runs
+    frames += reversePool.activeThreadCount() > 0 ? reverseBlockFrames() : reversePrefetch.frames.size();
+    {
+        // Likewise a running playlist chunk counts as a full window
+        QMutexLocker locker(&playlistMutex);
+        frames += playlistPool.activeThreadCount() > 0 ? std::max(playlistCache.size(), playlistPrefetchFrames())
+                                                       : playlistCache.size();
+    }
+    qint64 bytes = frames * frameBytes();
+    if (!currentFrameOrig.empty())
+        bytes += qint64(currentFrameOrig.total() * currentFrameOrig.elemSize());
+    bytes += qint64(basePixmap.width()) * basePixmap.height() * basePixmap.depth() / 8;
+
+    MemoryBudget &budget = MemoryBudget::instance();
+    budget.setUsage(framesBudget, bytes);
+    budget.setUsage(tilesBudget, tileCacheBytes);
+    budget.setUsage(thumbnailsBudget, videoCache.thumbnailBytes());
+}
+
+qint64 VideoWidget::evictDecodedFrames()
+{
+    // Prefetched frames are decoded again when needed; a running prefetch is left to finish
+    qint64 frames = 0;
+    if (reversePool.waitForDone(0)) {
+        frames += reversePrefetch.frames.size();
+        reversePrefetch = FrameBlock();
+    }
+    // The block being played backwards is still needed
+    if (!(playing && reverse)) {
+        frames += reverseBlock.frames.size();
+        reverseBlock = FrameBlock();
+    }
+    // Likewise the frames ahead of a playing track, dropping them would only queue them again
+    if (!(playing && !playlist.isEmpty())) {
+        {
+            QMutexLocker locker(&playlistMutex);
+            frames += playlistCache.size();
+        }
+        stopPlaylistPrefetch();
+        playlistPrefetchedTo = std::max(0, playlistPos + 1);
+    }
+    return frames * frameBytes();
+}
+
+qint64 VideoWidget::evictTiles()
+{
+    qint64 freed = tileCacheBytes;
+    clearTileCache();
+    return freed;
+}
+
+qint64 VideoWidget::evictThumbnails()
+{
+    // Slider previews are off until the video is opened again
+    qint64 freed = videoCache.thumbnailBytes();
+    videoCache.unloadThumbnails();
+    reportMemory();
+    return freed;
+}
+
+void VideoWidget::setOverlayFilter(const OverlayFilter &filter)
+{
+    overlayFilter = filter;
+    overlayTimer->start();
+}
+
+bool VideoWidget::updateOutputSize()
+{
+    // Zoomed views are built from tiles of native pixels
+    QSize size = zoom > 1.0 ? QSize() : label->size();
+    if (size == decodeSize || !decoder || !decoder->isOpened())
+        return false;
+    decodeSize = size;
+
+    // Frames decoded ahead are at the old size
+    stopReverseDecode();
+    stopPlaylistPrefetch();
+    playlistPrefetchedTo = std::max(0, playlistPos + 1);
+    clearTileCache();
+    decoder->setOutputSize(decodeSize);
+    if (playlistDecoder)
+        playlistDecoder->setOutputSize(decodeSize);
+
+    cv::Mat frame;
+    if (!currentFrameOrig.empty() && readFrameAt(currentFrameIdx, frame))
+        currentFrameOrig = frame;
+    return true;
+}
+
+void VideoWidget::decodeAtViewSize()
+{
+    if (updateOutputSize() && !currentFrameOrig.empty())
+        showFrame(currentFrameOrig, currentFrameIdx);
+}
+
+int VideoWidget::frameStep() const
+{
+    return std::max(1, static_cast<int>(std::ceil(fps * rate / maxPresentFps)));
+}
+
+void VideoWidget::restartTimer()
+{
+    int interval = static_cast<int>(1000.0 * frameStep() / (fps * rate));
+    timer->start(std::max(1, interval));
+}
+
+void VideoWidget::setPlaybackRate(double newRate)
+{
+    rate = std::max(minPlaybackRate, std::min(newRate, maxPlaybackRate));
+    if (playing)
+        restartTimer();
+    emit playbackRateChanged(rate, reverse);
+}
+
+double VideoWidget::playbackRate() const
+{
+    return rate;
+}
+
+void VideoWidget::setReverse(bool newReverse)
+{
+    reverse = newReverse;
+    emit playbackRateChanged(rate, reverse);
+}
+
+bool VideoWidget::isReverse() const
+{
+    return reverse;
+}
+
 void VideoWidget::timerNextFrame()
 {
-    nextFrame();
+    int step = frameStep();
+    if (!playlist.isEmpty()) {
+        // Track playback, forward only
+        int pos = playlistPos + step;
+        if (pos >= playlist.size() || !showPlaylistPos(pos))
+            pause();
+        return;
+    }
+
+    int goTo = currentFrameIdx + (reverse ? -step : step);
+    if (goTo < 0 || goTo >= totalFrames) {
+        pause();
+        return;
+    }
+
+    cv::Mat frame;
+    bool ok = reverse ? reverseFrameAt(goTo, step, frame) : readFrameAt(goTo, frame);
+    if (!ok) {
+        label->setText("Failed to read frame.");
+        pause();
+        return;
+    }
+    currentFrameIdx = goTo;
+    currentFrameOrig = frame;
+    showFrame(frame, currentFrameIdx);
+    updateSlider();
 }
 
 void VideoWidget::resizeEvent(QResizeEvent *event)
 {
-    // Re-display to update scaling
+    // Re-display to update scaling, decode at the new size once the resize settles
     if (!currentFrameOrig.empty())
         showFrame(currentFrameOrig, currentFrameIdx);
+    resizeTimer->start();
     QWidget::resizeEvent(event);
 }
 
+QRectF VideoWidget::viewRect(QSize frameSize) const
+{
+    // Part of the frame (in frame pixels) that is visible at the current zoom
+    double w = frameSize.width() / zoom;
+    double h = frameSize.height() / zoom;
+    double x = viewCenter.x() * frameSize.width() - w / 2;
+    double y = viewCenter.y() * frameSize.height() - h / 2;
+    x = std::max(0.0, std::min(x, frameSize.width() - w));
+    y = std::max(0.0, std::min(y, frameSize.height() - h));
+    return QRectF(x, y, w, h);
+}
+
+QPointF VideoWidget::displayPos(const QPoint &widgetPos) const
+{
+    // label centers the pixmap
+    QPoint labelPos = label->mapFrom(this, widgetPos);
+    return QPointF(labelPos.x() - (label->width() - displayedSize.width()) / 2.0,
+                   labelPos.y() - (label->height() - displayedSize.height()) / 2.0);
+}
+
+void VideoWidget::clearTileCache()
+{
+    tileCache.clear();
+    tileCacheFrameIdx = -1;
+    tileCacheBytes = 0;
+    MemoryBudget::instance().setUsage(tilesBudget, 0);
+}
+
+QPixmap VideoWidget::zoomTile(const cv::Mat &frame, int tileX, int tileY)
+{
+    quint32 key = (static_cast<quint32>(tileY) << 16) | static_cast<quint32>(tileX);
+    auto it = tileCache.constFind(key);
+    if (it != tileCache.constEnd())
+        return it.value();
+
+    int x = tileX * zoomTileSize;
+    int y = tileY * zoomTileSize;
+    int w = std::min(zoomTileSize, frame.cols - x);
+    int h = std::min(zoomTileSize, frame.rows - y);
+    cv::Mat roi = frame(cv::Rect(x, y, w, h));
+    QImage img(roi.data, w, h, static_cast<int>(roi.step), QImage::Format_RGB888);
+    QPixmap tile = QPixmap::fromImage(img);
+    tileCache.insert(key, tile);
+    tileCacheBytes += qint64(tile.width()) * tile.height() * tile.depth() / 8;
+    MemoryBudget::instance().setUsage(tilesBudget, tileCacheBytes);
+    return tile;
+}
+
+QPixmap VideoWidget::renderZoomed(const cv::Mat &frame, int frameIdx, QSize displaySize, QRectF &frameRect)
+{
+    // Tiles stay valid while the frame does, so panning only converts newly visible tiles
+    if (frameIdx != tileCacheFrameIdx) {
+        clearTileCache();
+        tileCacheFrameIdx = frameIdx;
+    }
+
+    QRectF roi = viewRect(QSize(frame.cols, frame.rows));
+    double sx = displaySize.width() / roi.width();
+    double sy = displaySize.height() / roi.height();
+
+    QPixmap pixmap(displaySize);
+    pixmap.fill(Qt::black);
+    {
+        QPainter painter(&pixmap);
+        painter.setRenderHint(QPainter::SmoothPixmapTransform);
+
+        int firstX = static_cast<int>(roi.left()) / zoomTileSize;
+        int firstY = static_cast<int>(roi.top()) / zoomTileSize;
+        int lastX = std::min(static_cast<int>(std::ceil(roi.right())) - 1, frame.cols - 1) / zoomTileSize;
+        int lastY = std::min(static_cast<int>(std::ceil(roi.bottom())) - 1, frame.rows - 1) / zoomTileSize;
+        for (int ty = firstY; ty <= lastY; ++ty) {
+            for (int tx = firstX; tx <= lastX; ++tx) {
+                QPixmap tile = zoomTile(frame, tx, ty);
+                QRectF target((tx * zoomTileSize - roi.x()) * sx, (ty * zoomTileSize - roi.y()) * sy,
+                              tile.width() * sx, tile.height() * sy);
+                painter.drawPixmap(target, tile, QRectF(tile.rect()));
+            }
+        }
+    }
+
+    frameRect = QRectF(-roi.x() * sx, -roi.y() * sy, frame.cols * sx, frame.rows * sy);
+    return pixmap;
+}
+
+void VideoWidget::wheelEvent(QWheelEvent *event)
+{
+    if (currentFrameOrig.empty() || displayedSize.isEmpty()) {
+        QWidget::wheelEvent(event);
+        return;
+    }
+
+    QSize frameSize(currentFrameOrig.cols, currentFrameOrig.rows);
+    QRectF roi = viewRect(frameSize);
+    QPointF pos = displayPos(event->position().toPoint());
+    // Frame point under the cursor, kept under the cursor after zooming
+    QPointF anchor(roi.x() + pos.x() * roi.width() / displayedSize.width(),
+                   roi.y() + pos.y() * roi.height() / displayedSize.height());
+
+    double newZoom = zoom * std::pow(1.25, event->angleDelta().y() / 120.0);
+    zoom = std::max(1.0, std::min(newZoom, maxZoom));
+
+    double w = frameSize.width() / zoom;
+    double h = frameSize.height() / zoom;
+    double x = anchor.x() - pos.x() * w / displayedSize.width();
+    double y = anchor.y() - pos.y() * h / displayedSize.height();
+    viewCenter = QPointF((x + w / 2) / frameSize.width(), (y + h / 2) / frameSize.height());
+
+    setCursor(zoom > 1.0 ? Qt::OpenHandCursor : Qt::ArrowCursor);
+    updateOutputSize();
+    showFrame(currentFrameOrig, currentFrameIdx);
+    event->accept();
+}
+
+void VideoWidget::mousePressEvent(QMouseEvent *event)
+{
+    if (event->button() == Qt::LeftButton && zoom > 1.0 && label->geometry().contains(event->pos())) {
+        panning = true;
+        panLastPos = event->pos();
+        setCursor(Qt::ClosedHandCursor);
+        event->accept();
+        return;
+    }
+    QWidget::mousePressEvent(event);
+}
+
+void VideoWidget::mouseMoveEvent(QMouseEvent *event)
+{
+    if (!panning || currentFrameOrig.empty() || displayedSize.isEmpty()) {
+        QWidget::mouseMoveEvent(event);
+        return;
+    }
+
+    QSize frameSize(currentFrameOrig.cols, currentFrameOrig.rows);
+    QRectF roi = viewRect(frameSize);
+    QPoint delta = event->pos() - panLastPos;
+    panLastPos = event->pos();
+
+    // Start from the clamped view so dragging back from an edge reacts at once
+    double cx = roi.center().x() - delta.x() * roi.width() / displayedSize.width();
+    double cy = roi.center().y() - delta.y() * roi.height() / displayedSize.height();
+    viewCenter = QPointF(cx / frameSize.width(), cy / frameSize.height());
+
+    showFrame(currentFrameOrig, currentFrameIdx);
+    event->accept();
+}
+
+void VideoWidget::mouseReleaseEvent(QMouseEvent *event)
+{
+    if (panning && event->button() == Qt::LeftButton) {
+        panning = false;
+        setCursor(zoom > 1.0 ? Qt::OpenHandCursor : Qt::ArrowCursor);
+        event->accept();
+        return;
+    }
+    QWidget::mouseReleaseEvent(event);
+}
+
+void VideoWidget::mouseDoubleClickEvent(QMouseEvent *event)
+{
+    if (zoom > 1.0 && !currentFrameOrig.empty()) {
+        zoom = 1.0;
+        viewCenter = QPointF(0.5, 0.5);
+        unsetCursor();
+        updateOutputSize();
+        showFrame(currentFrameOrig, currentFrameIdx);
+        event->accept();
+        return;
+    }
+    QWidget::mouseDoubleClickEvent(event);
+}
+
 void VideoWidget::closeEvent(QCloseEvent *event)
 {
     timer->stop();
-    if (cap.isOpened())
-        cap.release();
+    saveSession();
+    stopThumbnails();
+    stopReverseDecode();
+    stopPlaylistPrefetch();
+    playlistDecoder.reset();
+    if (decoder)
+        decoder->close();
     QWidget::closeEvent(event); // call base class event handler
 }
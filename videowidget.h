@@ -4,10 +4,34 @@
 #include <QWidget>
 #include <QTimer>
 #include <QSlider>
+#include <QMap>
+#include <QThreadPool>
+#include <QHash>
+#include <QPixmap>
+#include <QPointF>
+#include <QMutex>
+#include <QVector>
+#include <memory>
+#include <atomic>
 #include <opencv2/opencv.hpp>
 #include "annotationparser.h"
+#include "annotationstats.h"
+#include "annotationoverlay.h"
+#include "trackindex.h"
+#include "decodebackend.h"
+#include "videocache.h"
 
 class QLabel;
+class QFileSystemWatcher;
+
+// Frames decoded forward in one go, to be presented backwards.
+// Holds every step-th frame from last down to first.
+struct FrameBlock {
+    int first = -1;
+    int last = -1;
+    int step = 1;
+    QMap<int, cv::Mat> frames;
+};
 
 class VideoWidget : public QWidget
 {
@@ -22,28 +46,96 @@ public:
     void pause();
     bool isPlaying() const;
 
+    // Playback speed, 0.25x to 8x of the file's fps
+    void setPlaybackRate(double rate);
+    double playbackRate() const;
+    void setReverse(bool reverse);
+    bool isReverse() const;
+
+    const AnnotationParser &annotations() const { return annotationParser; }
+    const AnnotationStats &annotationStatistics() const { return annotationStats; }
+    const TrackIndex &trackIndex() const { return tracks; }
+
+    // Which detections are drawn; only the overlay is redrawn, the frame is not decoded or scaled again
+    void setOverlayFilter(const OverlayFilter &filter);
+    const OverlayFilter &currentOverlayFilter() const { return overlayFilter; }
+
+    // Plays only the frames the tracker ID appears in, forward
+    void playTrack(int trackId);
+
 public slots:
     void nextFrame();
     void prevFrame();
     void saveCurrentFrame();
     void setFrameFromSlider(int frameNumber);
+    // Picks up detections appended to the annotation file
+    void reloadAnnotations();
+    // Back to playing all frames
+    void stopTrack();
 
 signals:
     void playStateChanged(bool playing);
     void frameInfoChanged(int frameNumber, QSize size);
     void frameSaved(const QString &filename);
+    void playbackRateChanged(double rate, bool reverse);
+    void annotationsChanged();
+    void trackPlaybackChanged(int trackId);   // -1 when stopped
 
 protected:
+    bool eventFilter(QObject *watched, QEvent *event) override;
     void closeEvent(QCloseEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
+    // Wheel zooms around the cursor, drag pans, double click fits the frame again
+    void wheelEvent(QWheelEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mouseReleaseEvent(QMouseEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
 
 private slots:
     void timerNextFrame();
+    void thumbnailsReady();
+    void composeOverlay();
+    // Re-decodes the shown frame once a resize has settled
+    void decodeAtViewSize();
+    // Reports the caches to MemoryBudget, also queued by the prefetch tasks when done
+    void reportMemory();
 
 private:
     void showFrame(const cv::Mat& frame, int frameIdx);
+    bool readFrameAt(int frameIdx, cv::Mat &frame);
+    bool reverseFrameAt(int frameIdx, int step, cv::Mat &frame);
+    void prefetchReverseBlock();
+    void stopReverseDecode();
+    int reverseBlockFrames() const;
+    bool showPlaylistPos(int pos);
+    bool playlistFrameAt(int pos, cv::Mat &frame);
+    void prefetchPlaylist();
+    void stopPlaylistPrefetch();
+    int playlistPrefetchFrames() const;
+    int frameStep() const;
+    // Decoders output the label size, native while zoomed; true if it changed
+    bool updateOutputSize();
+    void restartTimer();
+    QRectF viewRect(QSize frameSize) const;
+    QPointF displayPos(const QPoint &widgetPos) const;
+    QPixmap renderZoomed(const cv::Mat &frame, int frameIdx, QSize displaySize, QRectF &frameRect);
+    QPixmap zoomTile(const cv::Mat &frame, int tileX, int tileY);
+    void clearTileCache();
+    void saveSession();
+    // Statistics and tracks kept in the video cache, valid for one size and mtime of the annotation file
+    bool loadAnnotationIndexes();
+    void saveAnnotationIndexes();
+    void setAnnotationIndexKey(const QString &annotFile);
+    void startThumbnails();
+    void stopThumbnails();
+    // The evict functions are MemoryBudget callbacks, see reportMemory()
+    qint64 evictDecodedFrames();
+    qint64 evictTiles();
+    qint64 evictThumbnails();
+    qint64 frameBytes() const;
 
-    cv::VideoCapture cap;
+    std::unique_ptr<DecodeBackend> decoder;
     QTimer *timer;
     QLabel *label;
     QSlider *frameSlider;
@@ -51,11 +143,60 @@ private:
     bool playing;
     int currentFrameIdx;
     int totalFrames;
-    cv::Mat currentFrameOrig;
+    cv::Mat currentFrameOrig;   // RGB, at decodeSize
+    QSize decodeSize;           // Output size of the decoders, invalid = native
+    QTimer *resizeTimer;
     QString loadedFile;
 
+    double rate;
+    bool reverse;
+    FrameBlock reverseBlock;            // Block being presented backwards
+    FrameBlock reversePrefetch;         // Next block, filled on reversePool
+    QThreadPool reversePool;
+    std::unique_ptr<DecodeBackend> reverseDecoder;  // Only used by the reversePool task
+
+    QVector<int> playlist;              // Frames of the played track, empty = all frames
+    int playlistPos;
+    int playlistTrackId;
+    int playlistPrefetchedTo;           // Playlist positions before this are prefetched or queued
+    QThreadPool playlistPool;
+    std::unique_ptr<DecodeBackend> playlistDecoder; // Only used by the playlistPool task
+    QMutex playlistMutex;
+    QMap<int, cv::Mat> playlistCache;   // Prefetched track frames, guarded by playlistMutex
+    std::atomic<bool> playlistCancel;
+
+    double zoom;                        // 1 = whole frame fits
+    QPointF viewCenter;                 // Center of the view, normalized frame coordinates
+    bool panning;
+    QPoint panLastPos;
+    QSize displayedSize;                // Size of the pixmap shown in label
+    QPixmap basePixmap;                 // Shown frame, scaled, without overlay
+    QRectF baseFrameRect;               // Where the whole frame is on basePixmap
+    int baseFrameIdx;
+    std::shared_ptr<const FrameAnnotations> baseAnnotations;    // Of baseFrameIdx, keeps its page loaded
+    OverlayFilter overlayFilter;
+    QTimer *overlayTimer;               // Coalesces filter changes to one redraw
+    QHash<quint32, QPixmap> tileCache;  // Native resolution tiles of tileCacheFrameIdx
+    int tileCacheFrameIdx;
+    qint64 tileCacheBytes;
+
+    VideoCache videoCache;
+    QThreadPool thumbnailPool;
+    std::atomic<bool> thumbnailCancel;
+    QLabel *previewPopup;               // Slider hover preview
+
     AnnotationParser annotationParser;
+    AnnotationStats annotationStats;
+    TrackIndex tracks;
+    QFileSystemWatcher *annotationWatcher;
+    qint64 annotationFileSize;          // Annotation file as last parsed, key of the cached indexes
+    qint64 annotationFileTime;
+    bool annotationIndexesDirty;
     QSize annotationFrameSize;
+
+    int framesBudget;                   // MemoryBudget handles
+    int tilesBudget;
+    int thumbnailsBudget;
     void updateSlider();
     void setSliderRange();
 };